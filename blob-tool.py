@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""
+Blob Store Client
+Uploads lookup tables and calibration data into the device's storage partition
+and picks the blob process_data() uses, over Bluetooth LE or a wired link
+"""
+
+import asyncio
+import struct
+import hashlib
+import argparse
+import os
+
+from host_transport import (FRAME_BLOB_CHUNK, FRAME_BLOB_CONTROL, FRAME_BLOB_STATUS,
+                            FRAME_MAX_PAYLOAD, open_link)
+
+# Service and Characteristic UUIDs
+DATA_STREAM_SERVICE_UUID = "12345678-1234-5678-9ABC-DEF012345678"
+BLOB_CONTROL_CHAR_UUID   = "12345678-1234-5678-9ABC-DEF012345680"
+BLOB_DATA_CHAR_UUID      = "12345678-1234-5678-9ABC-DEF012345681"
+
+# Blob control commands (src/blob_store.h)
+BLOB_CMD_BEGIN = 0x01
+BLOB_CMD_COMMIT = 0x02
+BLOB_CMD_ABORT = 0x03
+BLOB_CMD_DELETE = 0x04
+BLOB_CMD_SELECT = 0x05
+
+# Upload states
+BLOB_STATE_IDLE = 0x00
+BLOB_STATE_RECEIVING = 0x01
+BLOB_STATE_RECEIVED = 0x02
+BLOB_STATE_COMMITTED = 0x03
+BLOB_STATE_ERROR = 0xFF
+
+STATE_NAMES = {
+    BLOB_STATE_IDLE: "IDLE",
+    BLOB_STATE_RECEIVING: "RECEIVING",
+    BLOB_STATE_RECEIVED: "RECEIVED",
+    BLOB_STATE_COMMITTED: "COMMITTED",
+    BLOB_STATE_ERROR: "ERROR"
+}
+
+TRANSFORMS = {"none": 0, "xor": 1, "lut": 2}
+
+# Data pages of the 32 KB storage partition (the first two pages are the index)
+BLOB_MAX_SIZE = 6 * 4096
+
+BLOB_STATUS_LEN = 9
+
+
+class BlobStatus:
+    """9-byte status record: state, id, last result, received, size, free pages, command count"""
+
+    def __init__(self, data):
+        (self.state, self.id, self.result, self.received, self.size, self.free_pages,
+         self.seq) = struct.unpack('<BBbHHBB', data[:BLOB_STATUS_LEN])
+
+    def __str__(self):
+        state = STATE_NAMES.get(self.state, f"0x{self.state:02X}")
+        return (f"{state}, blob {self.id}, {self.received}/{self.size} bytes, "
+                f"last result {self.result}, {self.free_pages} free pages")
+
+
+class BlobClient:
+    """Blob Control / Blob Data characteristics of the Data Stream service"""
+
+    def __init__(self, device_name="AlexBlue"):
+        self.device_name = device_name
+        self.client = None
+        # Chunks fit one write (MTU 247)
+        self.chunk_size = 240
+        # Writes the device rejects while its OTA queue is full
+        self.write_retries = 20
+        self.log = print
+
+    async def connect(self):
+        from bleak import BleakClient, BleakScanner
+        self.log(f"Scanning for device '{self.device_name}'...")
+        device = await BleakScanner.find_device_by_name(self.device_name, timeout=10.0)
+        if not device:
+            raise Exception(f"Device '{self.device_name}' not found")
+        self.client = BleakClient(device)
+        await self.client.connect()
+        self.log(f"Connected to {self.device_name} [{device.address}]")
+
+    async def disconnect(self):
+        if self.client and self.client.is_connected:
+            await self.client.disconnect()
+            self.log("Disconnected")
+
+    async def read_status(self):
+        return BlobStatus(await self.client.read_gatt_char(BLOB_CONTROL_CHAR_UUID))
+
+    async def await_status(self, accepted, timeout=10.0):
+        """Poll until the queued commands have run and the state is one of accepted"""
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout
+        while True:
+            status = await self.read_status()
+            if status.state in accepted:
+                return status
+            if status.state == BLOB_STATE_ERROR or status.result < 0:
+                raise Exception(f"Device reported {status}")
+            if loop.time() >= deadline:
+                raise Exception(f"Timeout, device reports {status}")
+            await asyncio.sleep(0.2)
+
+    async def write_with_retry(self, uuid, data):
+        """Write with response, backing off while the device's OTA queue is full"""
+        from bleak.exc import BleakError
+        for attempt in range(self.write_retries):
+            try:
+                await self.client.write_gatt_char(uuid, data, response=True)
+                return
+            except BleakError:
+                if attempt == self.write_retries - 1:
+                    raise
+                await asyncio.sleep(min(0.02 * 2 ** attempt, 0.5))
+
+    async def command(self, payload, timeout=10.0):
+        """Run a control command, returns the status once it has been handled"""
+        seq = (await self.read_status()).seq
+        await self.write_with_retry(BLOB_CONTROL_CHAR_UUID, payload)
+        # Commands queue behind earlier chunks, so poll until the count moves on
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout
+        while True:
+            status = await self.read_status()
+            if status.seq != seq:
+                break
+            if loop.time() >= deadline:
+                raise Exception(f"Command 0x{payload[0]:02X} not handled: {status}")
+            await asyncio.sleep(0.05)
+        if status.result < 0:
+            raise Exception(f"Command 0x{payload[0]:02X} failed: {status}")
+        return status
+
+    async def send_chunk(self, chunk):
+        await self.write_with_retry(BLOB_DATA_CHAR_UUID, chunk)
+
+
+class WiredBlobClient(BlobClient):
+    """Same requests as host_transport frames (USB, UART or native_sim pty)"""
+
+    def __init__(self, link):
+        super().__init__(link.port_name)
+        self.link = link
+        self.link.log = lambda msg: self.log(msg)
+        self.chunk_size = FRAME_MAX_PAYLOAD
+
+    async def connect(self):
+        self.link.open()
+
+    async def disconnect(self):
+        self.link.close()
+
+    async def blob_request(self, frame_type, payload=b''):
+        reply = await asyncio.to_thread(self.link.transact, frame_type, payload)
+        result = struct.unpack('<b', reply[:1])[0]
+        if len(reply) < 1 + BLOB_STATUS_LEN:
+            raise Exception(f"Request rejected (error {result})")
+        status = BlobStatus(reply[1:1 + BLOB_STATUS_LEN])
+        if result != 0:
+            raise Exception(f"Device returned error {result}: {status}")
+        return status
+
+    async def read_status(self):
+        return await self.blob_request(FRAME_BLOB_STATUS)
+
+    async def command(self, payload):
+        return await self.blob_request(FRAME_BLOB_CONTROL, payload)
+
+    async def send_chunk(self, chunk):
+        await self.blob_request(FRAME_BLOB_CHUNK, chunk)
+
+
+async def upload(client, blob_id, path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not data or len(data) > BLOB_MAX_SIZE:
+        raise Exception(f"Blob must be 1..{BLOB_MAX_SIZE} bytes, {path} has {len(data)}")
+
+    digest = hashlib.sha256(data).digest()
+    client.log(f"Blob {blob_id}: {os.path.basename(path)}, {len(data)} bytes, sha256 {digest.hex()}")
+
+    try:
+        await client.command(bytes([BLOB_CMD_BEGIN, blob_id]) + struct.pack('<I', len(data)) + digest)
+        await client.await_status({BLOB_STATE_RECEIVING})
+        for offset in range(0, len(data), client.chunk_size):
+            await client.send_chunk(data[offset:offset + client.chunk_size])
+        await client.await_status({BLOB_STATE_RECEIVED})
+        await client.command(bytes([BLOB_CMD_COMMIT]))
+        status = await client.await_status({BLOB_STATE_COMMITTED})
+    except Exception:
+        await client.command(bytes([BLOB_CMD_ABORT]))
+        raise
+    client.log(f"Committed: {status}")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="Blob Store Client")
+    parser.add_argument("--device", default="AlexBlue", help="Device name to connect to")
+    parser.add_argument("--transport", choices=["ble", "usb", "uart", "sim"], default="ble",
+                        help="Link to the device (sim = native_sim emulator pty)")
+    parser.add_argument("--port", default=None,
+                        help="Serial port of the wired transport (default /dev/ttyACM1 for USB, /dev/ttyUSB1 for UART)")
+    parser.add_argument("--baudrate", type=int, default=1000000, help="Baud rate of the data stream UART")
+    sub = parser.add_subparsers(dest="action", required=True)
+    p = sub.add_parser("upload", help="Upload (or replace) a blob")
+    p.add_argument("id", type=int)
+    p.add_argument("file")
+    p = sub.add_parser("delete", help="Delete a blob")
+    p.add_argument("id", type=int)
+    p = sub.add_parser("select", help="Use a blob in process_data")
+    p.add_argument("id", type=int)
+    p.add_argument("transform", choices=list(TRANSFORMS))
+    sub.add_parser("status", help="Show the upload status")
+
+    args = parser.parse_args()
+
+    if getattr(args, "id", 1) not in range(1, 255):
+        parser.error("Blob ids are 1..254")
+
+    if args.transport != "ble":
+        client = WiredBlobClient(open_link(args.transport, args.port, args.baudrate))
+    else:
+        client = BlobClient(args.device)
+
+    try:
+        await client.connect()
+        if args.action == "upload":
+            await upload(client, args.id, args.file)
+        elif args.action == "delete":
+            await client.command(bytes([BLOB_CMD_DELETE, args.id]))
+            print(f"Blob {args.id} deleted")
+        elif args.action == "select":
+            await client.command(bytes([BLOB_CMD_SELECT, args.id, TRANSFORMS[args.transform]]))
+            print(f"process_data now uses blob {args.id} as {args.transform}")
+        else:
+            print(await client.read_status())
+    except KeyboardInterrupt:
+        print("\nInterrupted by user")
+    except Exception as e:
+        print(f"Error: {e}")
+        raise SystemExit(1)
+    finally:
+        await client.disconnect()
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -1,16 +1,19 @@
 #!/usr/bin/env python3
 """
 Firmware Update Client for Custom OTA Service
-Sends firmware files over Bluetooth LE to the nRF52840 device
+Sends firmware files over Bluetooth LE or a wired link (USB, UART, native_sim) to the device
 """
 
 import asyncio
 import struct
 import hashlib
 import zlib
-from bleak import BleakClient, BleakScanner
 import argparse
 import os
+import time
+
+from host_transport import (FRAME_FW_CHUNK, FRAME_FW_CONTROL, FRAME_FW_STATUS,
+                            FRAME_MAX_PAYLOAD, open_link)
 
 # Service and Characteristic UUIDs
 DATA_STREAM_SERVICE_UUID   = "12345678-1234-5678-9ABC-DEF012345678"
@@ -35,6 +38,7 @@ FW_STATUS_VERIFYING = 0x03
 FW_STATUS_VERIFIED = 0x04
 FW_STATUS_FLASHING = 0x05
 FW_STATUS_COMPLETE = 0x06
+FW_STATUS_PENDING = 0x07
 FW_STATUS_ERROR = 0xFF
 
 STATUS_NAMES = {
@@ -45,38 +49,99 @@ STATUS_NAMES = {
     FW_STATUS_VERIFIED: "VERIFIED",
     FW_STATUS_FLASHING: "FLASHING",
     FW_STATUS_COMPLETE: "COMPLETE",
+    FW_STATUS_PENDING: "PENDING",
     FW_STATUS_ERROR: "ERROR"
 }
 
+OTA_IV_LEN = 16
+
+
+def encrypt_image(data, key, iv):
+    """AES-128-CTR with a 128 bit big endian counter starting at iv, as the device decrypts it"""
+    try:
+        from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+    except ImportError:
+        raise Exception("Encrypted updates need the 'cryptography' package (pip install cryptography)")
+    encryptor = Cipher(algorithms.AES(key), modes.CTR(iv)).encryptor()
+    return encryptor.update(data) + encryptor.finalize()
+
+
+class FirmwareImage:
+    """Firmware file read, digested and chunked once, then shared by every session"""
+
+    # Slot 1 size (472 kB)
+    MAX_SIZE = 483328
+
+    def __init__(self, path, chunk_size=240, key=None):
+        if not os.path.exists(path):
+            raise Exception(f"Firmware file not found: {path}")
+        with open(path, 'rb') as f:
+            data = f.read()
+        if len(data) > self.MAX_SIZE:
+            raise Exception(f"Firmware too large: {len(data)} bytes (max: {self.MAX_SIZE} bytes)")
+
+        self.path = path
+        self.size = len(data)
+        self.chunk_size = chunk_size
+        # zlib.crc32 is the same reflected 0xEDB88320 CRC32 the device computes
+        self.crc32 = zlib.crc32(data) & 0xFFFFFFFF
+        self.sha256 = hashlib.sha256(data).hexdigest()
+        # Digests cover the plaintext the device writes to flash; only the chunks are encrypted
+        self.iv = os.urandom(OTA_IV_LEN) if key else None
+        if key:
+            data = encrypt_image(data, key, self.iv)
+        view = memoryview(data)
+        self.chunks = [bytes(view[i:i + chunk_size]) for i in range(0, self.size, chunk_size)]
+
+    @property
+    def start_payload(self):
+        """FW_CMD_START argument: LE32 size, then the initial counter block if encrypted"""
+        return struct.pack('<I', self.size) + (self.iv or b'')
+
+
 class FirmwareUpdater:
-    def __init__(self, device_name="AlexBlue"):
+    def __init__(self, device_name="AlexBlue", address=None, adapter=None):
         self.device_name = device_name
+        self.address = address
+        self.adapter = adapter
         self.client = None
         self.status_received = asyncio.Event()
         self.last_status = None
+        # Pause between chunks - the write responses already pace BLE
+        self.chunk_delay = 0
+        # Writes the device rejects while its OTA queue is full
+        self.write_retries = 20
+        # Per-chunk logging, turned off when many devices update at once
+        self.verbose = True
+        self.log = print
         
+    def adapter_kwargs(self):
+        return {"adapter": self.adapter} if self.adapter else {}
+    
     async def find_device(self):
         """Find the target device by name"""
-        print(f"Scanning for device '{self.device_name}'...")
-        devices = await BleakScanner.discover(timeout=10.0)
+        from bleak import BleakScanner
+        self.log(f"Scanning for device '{self.device_name}'...")
+        devices = await BleakScanner.discover(timeout=10.0, **self.adapter_kwargs())
         
         for device in devices:
             if device.name == self.device_name:
-                print(f"Found device: {device.name} [{device.address}]")
+                self.log(f"Found device: {device.name} [{device.address}]")
                 return device.address
         
         raise Exception(f"Device '{self.device_name}' not found")
     
     async def connect(self):
         """Connect to the device"""
-        address = await self.find_device()
-        self.client = BleakClient(address)
+        from bleak import BleakClient
+        address = self.address or await self.find_device()
+        self.client = BleakClient(address, **self.adapter_kwargs())
         await self.client.connect()
-        print(f"Connected to {self.device_name}")
+        self.log(f"Connected to {self.device_name}")
         
         # Enable status notifications
         await self.client.start_notify(FIRMWARE_STATUS_CHAR_UUID, self.status_notification_handler)
-        print("Status notifications enabled")
+        self.log("Status notifications enabled")
         
         # Longer delay to ensure notifications are properly subscribed
         await asyncio.sleep(1.0)
@@ -85,236 +150,381 @@ class FirmwareUpdater:
         """Disconnect from the device"""
         if self.client and self.client.is_connected:
             await self.client.disconnect()
-            print("Disconnected")
+            self.log("Disconnected")
     
     def status_notification_handler(self, sender, data):
         """Handle firmware status notifications"""
-        print(f"Received notification: {len(data)} bytes - {data.hex()}")
+        self.log(f"Received notification: {len(data)} bytes - {data.hex()}")
         if len(data) >= 8:
-            status = data[0]
-            received = struct.unpack('<I', data[1:5])[0]
-            # Expected size is in bytes 5-7 (only 3 bytes), construct 4-byte value
-            expected = data[5] | (data[6] << 8) | (data[7] << 16)
-            
+            status, received, expected = self.handle_status(data)
             status_name = STATUS_NAMES.get(status, f"UNKNOWN(0x{status:02X})")
-            print(f"Status: {status_name}, Received: {received}/{expected} bytes")
-            
-            self.last_status = status
+            self.log(f"Status: {status_name}, Received: {received}/{expected} bytes")
             self.status_received.set()
         else:
-            print(f"Invalid notification data length: {len(data)}")
+            self.log(f"Invalid notification data length: {len(data)}")
     
-    async def wait_for_status(self, expected_status=None, timeout=30.0):
-        """Wait for a status notification"""
-        try:
-            await asyncio.wait_for(self.status_received.wait(), timeout=timeout)
+    def handle_status(self, data):
+        """Decode an 8-byte status record"""
+        status = data[0]
+        received = struct.unpack('<I', data[1:5])[0]
+        # Expected size is in bytes 5-7 (only 3 bytes), construct 4-byte value
+        expected = data[5] | (data[6] << 8) | (data[7] << 16)
+        
+        self.last_status = status
+        return status, received, expected
+    
+    async def await_status(self, accepted, timeout=30.0, poll_interval=0.2):
+        """Wait until the device reports one of the accepted states.
+        
+        The device does not notify status changes, so the status is read back
+        and re-read whenever a notification arrives or poll_interval elapses.
+        Only notifications set status_received, so the reads stay paced.
+        """
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout
+        while True:
             self.status_received.clear()
-            
-            if expected_status is not None and self.last_status != expected_status:
-                status_name = STATUS_NAMES.get(self.last_status, f"0x{self.last_status:02X}")
-                expected_name = STATUS_NAMES.get(expected_status, f"0x{expected_status:02X}")
-                raise Exception(f"Expected status {expected_name}, got {status_name}")
-                
-            return self.last_status
-        except asyncio.TimeoutError:
-            raise Exception(f"Timeout waiting for status notification")
+            status, received, expected = await self.read_status()
+            if status in accepted:
+                return status
+            if status == FW_STATUS_ERROR:
+                raise Exception(f"Device reported ERROR at {received}/{expected} bytes")
+            if loop.time() >= deadline:
+                status_name = STATUS_NAMES.get(status, f"0x{status:02X}")
+                expected_names = "/".join(STATUS_NAMES[s] for s in accepted)
+                raise Exception(f"Expected status {expected_names}, got {status_name}")
+            try:
+                await asyncio.wait_for(self.status_received.wait(), timeout=poll_interval)
+            except asyncio.TimeoutError:
+                pass
     
     async def read_status(self):
         """Read current firmware status"""
         data = await self.client.read_gatt_char(FIRMWARE_STATUS_CHAR_UUID)
         if len(data) >= 8:
-            status = data[0]
-            received = struct.unpack('<I', data[1:5])[0]
-            # Expected size is in bytes 5-7 (only 3 bytes), construct 4-byte value
-            expected = data[5] | (data[6] << 8) | (data[7] << 16)
-            return status, received, expected
+            return self.handle_status(data)
         return None, 0, 0
     
+    async def write_with_retry(self, uuid, data):
+        """Write with response, backing off while the device's OTA queue is full"""
+        from bleak.exc import BleakError
+        for attempt in range(self.write_retries):
+            try:
+                await self.client.write_gatt_char(uuid, data, response=True)
+                return
+            except BleakError:
+                if attempt == self.write_retries - 1:
+                    raise
+                await asyncio.sleep(min(0.02 * 2 ** attempt, 0.5))
+    
     async def send_command(self, command, data=b''):
         """Send a firmware control command"""
         cmd_data = bytes([command]) + data
-        await self.client.write_gatt_char(FIRMWARE_CONTROL_CHAR_UUID, cmd_data)
+        await self.write_with_retry(FIRMWARE_CONTROL_CHAR_UUID, cmd_data)
     
     async def send_firmware_chunk(self, chunk):
         """Send a firmware data chunk"""
-        await self.client.write_gatt_char(FIRMWARE_UPDATE_CHAR_UUID, chunk, response=False)
-    
-    def calculate_crc32(self, data):
-        """Calculate CRC32 (same algorithm as device)"""
-        crc = 0xFFFFFFFF
-        polynomial = 0xEDB88320
-        
-        for byte in data:
-            crc ^= byte
-            for _ in range(8):
-                if crc & 1:
-                    crc = (crc >> 1) ^ polynomial
-                else:
-                    crc >>= 1
-        
-        return (~crc) & 0xFFFFFFFF
+        await self.write_with_retry(FIRMWARE_UPDATE_CHAR_UUID, chunk)
     
-    async def update_firmware(self, firmware_path, chunk_size=240, auto_reboot=False):
+    async def update_firmware(self, firmware_path, chunk_size=240, auto_reboot=False, key=None):
         """Update firmware from file"""
-        if not os.path.exists(firmware_path):
-            raise Exception(f"Firmware file not found: {firmware_path}")
-        
-        # Read firmware file
-        with open(firmware_path, 'rb') as f:
-            firmware_data = f.read()
-        
-        firmware_size = len(firmware_data)
-        print(f"Firmware file: {firmware_path}")
-        print(f"Firmware size: {firmware_size} bytes")
-        
-        # Check if firmware fits in device buffer (480 kB)
-        max_size = 483328
-        if firmware_size > max_size:
-            raise Exception(f"Firmware too large: {firmware_size} bytes (max: {max_size} bytes)")
-        
-        # Calculate CRC32
-        crc32 = self.calculate_crc32(firmware_data)
-        print(f"Firmware CRC32: 0x{crc32:08X}")
-        
+        image = FirmwareImage(firmware_path, chunk_size, key)
+        self.log(f"Firmware file: {image.path}")
+        self.log(f"Firmware size: {image.size} bytes")
+        self.log(f"Firmware CRC32: 0x{image.crc32:08X}")
+        if image.iv:
+            self.log("Encryption: AES-128-CTR")
+        start = time.monotonic()
+        sent = await self.update_image(image, auto_reboot)
+        elapsed = time.monotonic() - start
+        self.log(f"Transferred {sent} bytes in {elapsed:.1f} s ({sent / elapsed / 1024:.1f} KB/s)")
+    
+    async def resume_offset(self, image):
+        """Bytes of image the device already holds from an interrupted session"""
+        status, received, expected = await self.read_status()
+        if expected != image.size:
+            return 0
+        if status == FW_STATUS_RECEIVED and received == image.size:
+            return received
+        if status == FW_STATUS_RECEIVING and received % image.chunk_size == 0:
+            return received
+        return 0
+    
+    async def update_image(self, image, auto_reboot=False, resume=False, abort_on_error=True):
+        """Run START/chunks/VERIFY/FLASH for a prepared image, returns bytes sent"""
+        bytes_sent = await self.resume_offset(image) if resume else 0
         try:
-            # Step 1: Start firmware update
-            print("\\n1. Starting firmware update...")
-            size_data = struct.pack('<I', firmware_size)
-            print(f"   Sending START command with size: {firmware_size} bytes")
-            print(f"   Size data: {size_data.hex()}")
-            await self.send_command(FW_CMD_START, size_data)
-            
-            # Add a small delay and check status manually if no notification arrives
-            try:
-                await self.wait_for_status(FW_STATUS_RECEIVING, timeout=5.0)
-            except Exception as e:
-                print(f"   No notification received, checking status manually...")
-                status, received, expected = await self.read_status()
-                status_name = STATUS_NAMES.get(status, f"UNKNOWN(0x{status:02X})")
-                print(f"   Manual status check: {status_name}, Received: {received}/{expected}")
-                if status != FW_STATUS_RECEIVING:
-                    raise e
+            if bytes_sent:
+                self.log(f"\n1. Resuming firmware update at {bytes_sent}/{image.size} bytes")
+            else:
+                # Step 1: Start firmware update
+                self.log("\n1. Starting firmware update...")
+                self.log(f"   Sending START command with size: {image.size} bytes")
+                await self.send_command(FW_CMD_START, image.start_payload)
+                await self.await_status({FW_STATUS_RECEIVING})
             
             # Step 2: Send firmware chunks
-            print("\\n2. Sending firmware chunks...")
-            bytes_sent = 0
-            chunk_count = 0
-
-            while bytes_sent < firmware_size:
-                chunk_end = min(bytes_sent + chunk_size, firmware_size)
-                chunk = firmware_data[bytes_sent:chunk_end]
-                
-                print(f"  Sending chunk {chunk_count + 1}: {len(chunk)} bytes")
+            self.log("\n2. Sending firmware chunks...")
+            first_chunk = bytes_sent // image.chunk_size
+            sent_now = 0
+            for chunk_count, chunk in enumerate(image.chunks[first_chunk:], first_chunk + 1):
+                if self.verbose:
+                    self.log(f"  Sending chunk {chunk_count}: {len(chunk)} bytes")
                 await self.send_firmware_chunk(chunk)
-                bytes_sent = chunk_end
-                chunk_count += 1
+                bytes_sent += len(chunk)
+                sent_now += len(chunk)
                 
-                if chunk_count % 10 == 0 or bytes_sent >= firmware_size:
-                    print(f"  Sent {bytes_sent}/{firmware_size} bytes ({bytes_sent*100//firmware_size}%)")
+                if (self.verbose and chunk_count % 10 == 0) or bytes_sent >= image.size:
+                    self.log(f"  Sent {bytes_sent}/{image.size} bytes ({bytes_sent*100//image.size}%)")
                 
                 # Small delay to avoid overwhelming the device
-                await asyncio.sleep(0.01)
-            
-            print(f"\\n   All chunks sent. Checking device status...")
-            # Check status manually after sending all data
-            status, received, expected = await self.read_status()
-            status_name = STATUS_NAMES.get(status, f"UNKNOWN(0x{status:02X})")
-            print(f"   Device status: {status_name}, Received: {received}/{expected}")
+                if self.chunk_delay:
+                    await asyncio.sleep(self.chunk_delay)
             
             # Wait for reception complete
-            await self.wait_for_status(FW_STATUS_RECEIVED)
-            print("\\n3. Firmware reception complete")
+            await self.await_status({FW_STATUS_RECEIVED})
+            self.log("\n3. Firmware reception complete")
             
             # Step 3: Verify firmware
-            print("\\n4. Verifying firmware...")
-            crc_data = struct.pack('<I', crc32)
-            print(f"   Sending VERIFY command with CRC32: 0x{crc32:08X}")
-            print(f"   CRC data: {crc_data.hex()}")
-            await self.send_command(FW_CMD_VERIFY, crc_data)
-            
-            try:
-                status = await self.wait_for_status(timeout=10.0)
-            except Exception as e:
-                print(f"   No notification received, checking status manually...")
-                status, received, expected = await self.read_status()
-                status_name = STATUS_NAMES.get(status, f"UNKNOWN(0x{status:02X})")
-                print(f"   Manual status check: {status_name}, Received: {received}/{expected}")
-                if status not in [FW_STATUS_VERIFIED, FW_STATUS_VERIFYING]:
-                    raise e
-            
-            if status == FW_STATUS_VERIFIED:
-                print("   Firmware verification successful!")
-            elif status == FW_STATUS_VERIFYING:
-                print("   Verification in progress, waiting...")
-                status = await self.wait_for_status(timeout=10.0)
-                if status == FW_STATUS_VERIFIED:
-                    print("   Firmware verification successful!")
-                else:
-                    raise Exception("Firmware verification failed")
-            else:
-                raise Exception("Firmware verification failed")
+            self.log("\n4. Verifying firmware...")
+            self.log(f"   Sending VERIFY command with CRC32: 0x{image.crc32:08X}")
+            await self.send_command(FW_CMD_VERIFY, struct.pack('<I', image.crc32))
+            await self.await_status({FW_STATUS_VERIFIED})
+            self.log("   Firmware verification successful!")
             
             # Step 4: Flash firmware
-            print("\\n5. Flashing firmware...")
+            self.log("\n5. Flashing firmware...")
             await self.send_command(FW_CMD_FLASH)
+            await self.await_status({FW_STATUS_COMPLETE}, timeout=60.0)
+            self.log("   Firmware flashing completed!")
             
-            # Wait for FLASHING status first
-            try:
-                status = await self.wait_for_status(timeout=10.0)
-                if status == FW_STATUS_FLASHING:
-                    print("   Firmware flashing in progress...")
-                    # Wait for completion
-                    await self.wait_for_status(FW_STATUS_COMPLETE, timeout=60.0)
-                elif status == FW_STATUS_COMPLETE:
-                    print("   Firmware flashing completed!")
-                else:
-                    raise Exception(f"Unexpected status during flashing: {STATUS_NAMES.get(status, f'0x{status:02X}')}")
-            except Exception as e:
-                print(f"   No notification received, checking status manually...")
-                status, received, expected = await self.read_status()
-                status_name = STATUS_NAMES.get(status, f"UNKNOWN(0x{status:02X})")
-                print(f"   Manual status check: {status_name}, Received: {received}/{expected}")
-                if status == FW_STATUS_COMPLETE:
-                    print("   Firmware flashing completed!")
-                elif status == FW_STATUS_FLASHING:
-                    print("   Firmware flashing in progress...")
-                    await self.wait_for_status(FW_STATUS_COMPLETE, timeout=60.0)
-                else:
-                    raise e
-            
-            print("\\n🎉 Firmware update completed successfully!")
+            self.log("\n🎉 Firmware update completed successfully!")
             
             if auto_reboot:
-                print("\\n6. Swapping partitions and rebooting device...")
-                print("   Sending SWAP_AND_REBOOT command...")
+                self.log("\n6. Swapping partitions and rebooting device...")
+                self.log("   Sending SWAP_AND_REBOOT command...")
                 await self.send_command(FW_CMD_SWAP_AND_REBOOT)
-                print("   Device will reboot to apply new firmware!")
-                print("   Note: Device will disconnect during reboot.")
+                self.log("   Device will reboot to apply new firmware!")
+                self.log("   Note: Device will disconnect during reboot.")
             else:
-                print("\\n💡 To apply the new firmware, use:")
-                print("   python3 firmware-update.py --swap-and-reboot")
-                print("   Or send SWAP_AND_REBOOT command manually")
+                self.log("\n💡 To apply the new firmware, use:")
+                self.log("   python3 firmware-update.py --swap-and-reboot")
+                self.log("   Or send SWAP_AND_REBOOT command manually")
+            
+            return sent_now
             
         except Exception as e:
-            print(f"\\n❌ Firmware update failed: {e}")
-            print("Aborting update...")
-            await self.send_command(FW_CMD_ABORT)
+            self.log(f"\n❌ Firmware update failed: {e}")
+            if abort_on_error:
+                self.log("Aborting update...")
+                await self.send_command(FW_CMD_ABORT)
             raise
 
+class WiredFirmwareUpdater(FirmwareUpdater):
+    """Same update flow over a host_transport link (USB, UART or native_sim pty)"""
+
+    def __init__(self, link):
+        super().__init__(link.port_name)
+        self.link = link
+        self.link.log = lambda msg: self.log(msg)
+        # Every frame is acknowledged, so no pacing is needed
+        self.chunk_delay = 0
+
+    async def connect(self):
+        self.link.open()
+
+    async def disconnect(self):
+        self.link.close()
+
+    async def firmware_request(self, frame_type, payload=b''):
+        reply = await asyncio.to_thread(self.link.transact, frame_type, payload)
+        result = struct.unpack('<b', reply[:1])[0]
+        if len(reply) < 9:
+            raise Exception(f"Request rejected (error {result})")
+        status = self.handle_status(reply[1:9])
+        if result != 0:
+            raise Exception(f"Device returned error {result}")
+        return status
+
+    async def read_status(self):
+        return await self.firmware_request(FRAME_FW_STATUS)
+
+    async def send_command(self, command, data=b''):
+        payload = bytes([command]) + data
+        if command == FW_CMD_SWAP_AND_REBOOT:
+            # The device reboots before it can reply
+            self.link.send(FRAME_FW_CONTROL, payload)
+            return
+        await self.firmware_request(FRAME_FW_CONTROL, payload)
+
+    async def send_firmware_chunk(self, chunk):
+        await self.firmware_request(FRAME_FW_CHUNK, chunk)
+
+
+class FleetUpdater:
+    """Update many BLE devices concurrently, bounded per adapter.
+    
+    The image is prepared once and shared. Each adapter runs up to
+    max_per_adapter sessions at a time, so total time scales with the number of
+    adapters rather than the number of devices. Failed sessions are retried and
+    resume from the byte count the device already holds.
+    """
+
+    def __init__(self, image, name_prefix="AlexBlue", adapters=None, max_per_adapter=4,
+                 retries=3, scan_timeout=10.0, auto_reboot=False):
+        self.image = image
+        self.name_prefix = name_prefix
+        self.adapters = adapters or [None]
+        self.max_per_adapter = max_per_adapter
+        self.retries = retries
+        self.scan_timeout = scan_timeout
+        self.auto_reboot = auto_reboot
+        self.results = []
+
+    async def scan_adapter(self, adapter):
+        from bleak import BleakScanner
+        kwargs = {"adapter": adapter} if adapter else {}
+        found = await BleakScanner.discover(timeout=self.scan_timeout, return_adv=True, **kwargs)
+        return [(adapter, device, adv.rssi) for device, adv in found.values()
+                if device.name and device.name.startswith(self.name_prefix)]
+
+    async def discover(self, addresses=None):
+        """Scan on all adapters at once, assign each device to the adapter that hears it best"""
+        print(f"Scanning for '{self.name_prefix}*' on {len(self.adapters)} adapter(s)...")
+        sightings = await asyncio.gather(*(self.scan_adapter(a) for a in self.adapters))
+        best = {}
+        for adapter, device, rssi in (s for per_adapter in sightings for s in per_adapter):
+            if addresses and device.address not in addresses:
+                continue
+            if device.address not in best or rssi > best[device.address][2]:
+                best[device.address] = (adapter, device, rssi)
+        return list(best.values())
+
+    async def update_device(self, adapter, device, slots):
+        label = f"{device.address}@{adapter or 'default'}"
+        updater = FirmwareUpdater(device.name, device.address, adapter)
+        updater.verbose = False
+        updater.log = lambda msg, label=label: print(f"[{label}] {msg.strip()}") if msg.strip() else None
+        result = {"device": label, "ok": False, "attempts": 0, "bytes": 0, "seconds": 0.0, "error": None}
+        
+        start = time.monotonic()
+        for attempt in range(1, self.retries + 2):
+            result["attempts"] = attempt
+            # Hold the adapter's connection slot only while connected
+            async with slots:
+                try:
+                    await updater.connect()
+                    result["bytes"] += await updater.update_image(
+                        self.image, self.auto_reboot, resume=attempt > 1, abort_on_error=False)
+                    result["ok"] = True
+                    result["error"] = None
+                except Exception as e:
+                    result["error"] = str(e)
+                    updater.log(f"Attempt {attempt} failed: {e}")
+                finally:
+                    try:
+                        await updater.disconnect()
+                    except Exception:
+                        pass
+            if result["ok"]:
+                break
+            if attempt <= self.retries:
+                await asyncio.sleep(min(2 ** attempt, 10))
+        result["seconds"] = time.monotonic() - start
+        
+        self.results.append(result)
+        return result
+
+    async def run(self, addresses=None):
+        targets = await self.discover(addresses)
+        if not targets:
+            raise Exception(f"No devices matching '{self.name_prefix}' found")
+        print(f"Updating {len(targets)} device(s), image {self.image.size} bytes, "
+              f"CRC32 0x{self.image.crc32:08X}, SHA-256 {self.image.sha256[:16]}...")
+        
+        slots = {adapter: asyncio.Semaphore(self.max_per_adapter) for adapter in self.adapters}
+        start = time.monotonic()
+        await asyncio.gather(*(self.update_device(adapter, device, slots[adapter])
+                               for adapter, device, _ in targets))
+        self.print_summary(time.monotonic() - start)
+        return all(r["ok"] for r in self.results)
+
+    def print_summary(self, elapsed):
+        ok = [r for r in self.results if r["ok"]]
+        failed = [r for r in self.results if not r["ok"]]
+        total_bytes = sum(r["bytes"] for r in self.results)
+        
+        print("\n=== Fleet Update Summary ===")
+        for r in sorted(self.results, key=lambda r: r["device"]):
+            rate = r["bytes"] / r["seconds"] / 1024 if r["seconds"] else 0
+            state = "OK" if r["ok"] else f"FAILED ({r['error']})"
+            print(f"  {r['device']}: {state}, {r['attempts']} attempt(s), "
+                  f"{r['seconds']:.1f} s, {rate:.1f} KB/s")
+        print(f"Devices: {len(ok)} updated, {len(failed)} failed")
+        print(f"Elapsed: {elapsed:.1f} s, aggregate throughput {total_bytes / elapsed / 1024:.1f} KB/s")
+
+
 async def main():
     parser = argparse.ArgumentParser(description="Firmware Update Client")
     parser.add_argument("firmware", nargs='?', help="Path to firmware file")
     parser.add_argument("--device", default="AlexBlue", help="Device name to connect to")
-    parser.add_argument("--chunk-size", type=int, default=240, help="Chunk size for transfer")
+    parser.add_argument("--transport", choices=["ble", "usb", "uart", "sim"], default="ble",
+                        help="Link to the device (sim = native_sim emulator pty)")
+    parser.add_argument("--port", default=None,
+                        help="Serial port of the wired transport (default /dev/ttyACM1 for USB, /dev/ttyUSB1 for UART)")
+    parser.add_argument("--baudrate", type=int, default=1000000, help="Baud rate of the data stream UART")
+    parser.add_argument("--chunk-size", type=int, default=None,
+                        help="Chunk size for transfer (default 240 for BLE, 4096 for wired links)")
     parser.add_argument("--auto-reboot", action="store_true", help="Automatically reboot device after flashing")
     parser.add_argument("--swap-and-reboot", action="store_true", help="Only swap partitions and reboot (no firmware transfer)")
+    parser.add_argument("--encrypt", action="store_true",
+                        help="Send the image AES-128-CTR encrypted (decrypted per chunk on the device)")
+    parser.add_argument("--key", default=None,
+                        help="AES-128 key as 32 hex digits for --encrypt, the device's CONFIG_OTA_CRYPTO_KEY")
+    parser.add_argument("--fleet", action="store_true",
+                        help="Update every BLE device whose name starts with --device, concurrently")
+    parser.add_argument("--addresses", default=None, help="Comma separated addresses to restrict the fleet to")
+    parser.add_argument("--adapters", default=None, help="Comma separated Bluetooth adapters (e.g. hci0,hci1)")
+    parser.add_argument("--max-per-adapter", type=int, default=4, help="Concurrent connections per adapter")
+    parser.add_argument("--retries", type=int, default=3, help="Retries per device in fleet mode")
     
     args = parser.parse_args()
     
     if not args.firmware and not args.swap_and_reboot:
         parser.error("Either provide firmware file or use --swap-and-reboot")
     
-    updater = FirmwareUpdater(args.device)
+    key = None
+    if args.encrypt or args.key:
+        if not args.key:
+            parser.error("--encrypt needs --key (the device's CONFIG_OTA_CRYPTO_KEY)")
+        try:
+            key = bytes.fromhex(args.key)
+        except ValueError:
+            parser.error("--key must be hex")
+        if len(key) != 16:
+            parser.error("--key must be 16 bytes (32 hex digits)")
+    
+    if args.transport != "ble":
+        updater = WiredFirmwareUpdater(open_link(args.transport, args.port, args.baudrate))
+        chunk_size = args.chunk_size or FRAME_MAX_PAYLOAD
+    else:
+        updater = FirmwareUpdater(args.device)
+        chunk_size = args.chunk_size or 240
+    
+    if chunk_size % 4 != 0:
+        parser.error("Chunk size must be a multiple of 4 (flash word size)")
+    if args.transport != "ble" and chunk_size > FRAME_MAX_PAYLOAD:
+        parser.error(f"Wired frames carry at most {FRAME_MAX_PAYLOAD} bytes")
+    
+    if args.fleet:
+        if args.transport != "ble" or not args.firmware:
+            parser.error("--fleet needs a firmware file and the BLE transport")
+        fleet = FleetUpdater(FirmwareImage(args.firmware, chunk_size, key), args.device,
+                             args.adapters.split(",") if args.adapters else None,
+                             args.max_per_adapter, args.retries, auto_reboot=args.auto_reboot)
+        addresses = set(args.addresses.split(",")) if args.addresses else None
+        ok = await fleet.run(addresses)
+        raise SystemExit(0 if ok else 1)
     
     try:
         await updater.connect()
@@ -331,10 +541,10 @@ async def main():
             print(f"Initial status: {status_name}")
             
             # Update firmware
-            await updater.update_firmware(args.firmware, args.chunk_size, args.auto_reboot)
+            await updater.update_firmware(args.firmware, chunk_size, args.auto_reboot, key)
         
     except KeyboardInterrupt:
-        print("\\nInterrupted by user")
+        print("\nInterrupted by user")
     except Exception as e:
         print(f"Error: {e}")
     finally:
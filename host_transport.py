@@ -0,0 +1,181 @@
+"""
+Wired links to the device's framed protocol (see src/transport.h)
+
+FramedLink speaks the SOF/length/CRC frames used on the second USB CDC ACM
+port and on the native_sim emulator's uart1 pseudo-terminal. CobsLink carries
+the same type/payload/CRC as COBS packets on the data stream UART.
+"""
+
+import binascii
+import struct
+
+# Frame types
+FRAME_SOF = 0xA5
+FRAME_DATA = 0x01
+FRAME_FW_CONTROL = 0x02
+FRAME_FW_CHUNK = 0x03
+FRAME_FW_STATUS = 0x04
+FRAME_BLOB_CONTROL = 0x05
+FRAME_BLOB_CHUNK = 0x06
+FRAME_BLOB_STATUS = 0x07
+FRAME_REPLY = 0x80
+
+# Largest request payload the device accepts
+FRAME_MAX_PAYLOAD = 4096
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, same as crc16_itu_t(0xFFFF, ...) on the device"""
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def encode_frame(frame_type, payload=b''):
+    """Build a wire frame: SOF, type, LE16 length, payload, CRC-16/CCITT-FALSE"""
+    body = struct.pack('<BH', frame_type, len(payload)) + payload
+    return bytes([FRAME_SOF]) + body + struct.pack('<H', crc16(body))
+
+
+def cobs_encode(data):
+    """COBS encode data (delimiter not included)"""
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for byte in data:
+        if byte == 0:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+            continue
+        out.append(byte)
+        code += 1
+        if code == 0xFF:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """Decode one COBS packet (delimiter already stripped)"""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("Malformed COBS packet")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class FramedLink:
+    """Request/reply link over a serial port or pty using SOF frames"""
+
+    def __init__(self, port, baudrate=115200, timeout=30.0, log=print):
+        self.port_name = port
+        self.baudrate = baudrate
+        self.timeout = timeout
+        self.log = log
+        self.port = None
+
+    def open(self):
+        import serial
+        self.port = serial.Serial(self.port_name, self.baudrate, timeout=self.timeout)
+        self.port.reset_input_buffer()
+        self.log(f"Opened {self.port_name}")
+
+    def close(self):
+        if self.port and self.port.is_open:
+            self.port.close()
+            self.log("Closed")
+
+    def encode(self, frame_type, payload):
+        return encode_frame(frame_type, payload)
+
+    def read_reply(self):
+        """Read one frame, returns (type, payload)"""
+        while True:
+            sof = self.port.read(1)
+            if not sof:
+                raise Exception("Timeout waiting for reply frame")
+            if sof[0] != FRAME_SOF:
+                continue
+            header = self.port.read(3)
+            if len(header) < 3:
+                raise Exception("Truncated frame header")
+            frame_type, length = struct.unpack('<BH', header)
+            rest = self.port.read(length + 2)
+            if len(rest) < length + 2:
+                raise Exception("Truncated frame payload")
+            payload, crc = rest[:length], struct.unpack('<H', rest[length:])[0]
+            if crc16(header + payload) != crc:
+                self.log("Dropping reply frame with bad CRC")
+                continue
+            return frame_type, payload
+
+    def send(self, frame_type, payload=b''):
+        """Send a request without waiting for the reply"""
+        self.port.write(self.encode(frame_type, payload))
+        self.port.flush()
+
+    def transact(self, frame_type, payload=b''):
+        """Send a request and return the payload of its reply"""
+        self.port.write(self.encode(frame_type, payload))
+        reply_type, reply = self.read_reply()
+        if reply_type != (frame_type | FRAME_REPLY):
+            raise Exception(f"Unexpected reply type 0x{reply_type:02X}")
+        return reply
+
+
+class CobsLink(FramedLink):
+    """Same requests carried as COBS packets on the data stream UART (uart1)"""
+
+    def __init__(self, port, baudrate=1000000, timeout=30.0, log=print):
+        super().__init__(port, baudrate, timeout, log)
+
+    def open(self):
+        super().open()
+        self.log(f"Using COBS framing at {self.baudrate} baud")
+
+    def encode(self, frame_type, payload):
+        packet = bytes([frame_type]) + payload
+        packet += struct.pack('<H', crc16(packet))
+        return cobs_encode(packet) + b'\x00'
+
+    def read_reply(self):
+        while True:
+            raw = self.port.read_until(b'\x00')
+            if not raw.endswith(b'\x00'):
+                raise Exception("Timeout waiting for reply packet")
+            if len(raw) == 1:
+                continue
+            try:
+                packet = cobs_decode(raw[:-1])
+            except ValueError:
+                self.log("Dropping malformed reply packet")
+                continue
+            if len(packet) < 3 or crc16(packet[:-2]) != struct.unpack('<H', packet[-2:])[0]:
+                self.log("Dropping reply packet with bad CRC")
+                continue
+            return packet[0], packet[1:-2]
+
+
+# Default port for each wired transport; "sim" is the native_sim uart1 pty
+DEFAULT_PORTS = {
+    "usb": "/dev/ttyACM1",
+    "uart": "/dev/ttyUSB1",
+    "sim": None,
+}
+
+
+def open_link(transport, port=None, baudrate=1000000, log=print):
+    """Create a link for --transport usb|uart|sim"""
+    port = port or DEFAULT_PORTS[transport]
+    if not port:
+        raise Exception(f"--port is required for the {transport} transport "
+                        "(native_sim prints the uart1 pty at startup)")
+    if transport == "uart":
+        return CobsLink(port, baudrate, log=log)
+    return FramedLink(port, log=log)
@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Index entries are only ever appended or have single words cleared
+ * (commit, delete), so each flash word is written at most twice between
+ * erases. Once every slot of the index page in use has been taken, the
+ * live entries are copied to the other index page, whose header goes in
+ * last with the next generation. At boot the valid header with the higher
+ * generation wins, so a reset during compaction keeps the old index.
+ *
+ * blob_upload_lock serialises everything that changes the store. Readers
+ * only take blob_lock, which writers hold just around index updates that
+ * could pull a blob from under them (commit, delete, the switch to a
+ * compacted index), so a data transform never waits for a page erase or
+ * the digest check. Status reads take neither lock; they get the record
+ * published when blob_upload_lock was last released.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/storage/stream_flash.h>
+#include <zephyr/sys/byteorder.h>
+#include <psa/crypto.h>
+
+#ifdef CONFIG_FLASH_SIMULATOR
+#include <zephyr/drivers/flash/flash_simulator.h>
+#endif
+
+#include "blob_store.h"
+
+LOG_MODULE_REGISTER(blob_store, LOG_LEVEL_INF);
+
+#define BLOB_PAGE_SIZE      4096
+#define BLOB_PARTITION_SIZE FIXED_PARTITION_SIZE(storage_partition)
+/* Pages 0 and 1 take turns as the index, the rest hold blob data */
+#define BLOB_INDEX_PAGES    2
+#define BLOB_DATA_PAGES     (BLOB_PARTITION_SIZE / BLOB_PAGE_SIZE - BLOB_INDEX_PAGES)
+
+#define BLOB_INDEX_MAGIC    0x58444942  /* "BIDX" */
+#define BLOB_MAGIC          0x424C4F42  /* "BLOB" */
+#define BLOB_COMMITTED      0x434F4D54  /* "COMT" */
+#define BLOB_ERASED         0xFFFFFFFF
+
+struct blob_entry {
+	uint32_t magic;
+	uint8_t id;
+	uint8_t first_page;
+	uint8_t pages;
+	uint8_t reserved;
+	uint32_t size;
+	uint8_t digest[BLOB_DIGEST_LEN];
+	/* Written on their own after the entry has been claimed */
+	uint32_t committed;
+	uint32_t deleted;
+};
+
+struct blob_index_header {
+	uint32_t magic;
+	uint32_t generation;
+};
+
+#define BLOB_INDEX_ENTRIES \
+	((int)((BLOB_PAGE_SIZE - sizeof(struct blob_index_header)) / sizeof(struct blob_entry)))
+
+BUILD_ASSERT(sizeof(struct blob_entry) % 4 == 0, "index entries must be flash word aligned");
+BUILD_ASSERT(BLOB_DATA_PAGES <= 32, "page bitmap is a uint32_t");
+
+K_MUTEX_DEFINE(blob_upload_lock);
+K_MUTEX_DEFINE(blob_lock);
+
+static const struct flash_area *blob_fa;
+/* storage_partition as seen through the memory-mapped flash */
+static const uint8_t *blob_base;
+static const struct blob_entry *blob_index;
+/* Index page in use and its generation */
+static uint8_t blob_index_page;
+static uint32_t blob_index_gen;
+
+static struct {
+	uint8_t state;
+	uint8_t id;
+	int8_t result;
+	/* Counts the handled commands, so a client can tell when its own has run */
+	uint8_t seq;
+	int slot;
+	uint32_t size;
+	uint32_t received;
+	struct stream_flash_ctx stream;
+} blob_upload;
+
+static uint8_t blob_stream_buf[256];
+
+/* Status record as of the last blob_upload_unlock() */
+static struct k_spinlock blob_status_lock;
+static uint8_t blob_status[BLOB_STATUS_LEN];
+
+static uint8_t blob_transform_id;
+static enum blob_transform blob_transform_mode;
+
+static const uint8_t *blob_mapped_base(void)
+{
+#ifdef CONFIG_FLASH_SIMULATOR
+	size_t size;
+
+	return (const uint8_t *)flash_simulator_get_memory(FIXED_PARTITION_DEVICE(storage_partition),
+							     &size) +
+	       FIXED_PARTITION_OFFSET(storage_partition);
+#else
+	return (const uint8_t *)DT_REG_ADDR(DT_GPARENT(DT_NODELABEL(storage_partition))) +
+	       FIXED_PARTITION_OFFSET(storage_partition);
+#endif
+}
+
+/* Partition offset of the first entry on an index page */
+static off_t blob_index_offset(uint8_t page)
+{
+	return page * BLOB_PAGE_SIZE + sizeof(struct blob_index_header);
+}
+
+static void blob_index_use(uint8_t page, uint32_t gen)
+{
+	blob_index_page = page;
+	blob_index_gen = gen;
+	blob_index = (const struct blob_entry *)(blob_base + blob_index_offset(page));
+}
+
+/* The generation goes in first, so a header with its magic is complete */
+static int blob_index_header_write(uint8_t page, uint32_t gen)
+{
+	uint32_t magic = BLOB_INDEX_MAGIC;
+	off_t off = page * BLOB_PAGE_SIZE;
+	int err = flash_area_write(blob_fa, off + offsetof(struct blob_index_header, generation),
+				   &gen, sizeof(gen));
+
+	if (!err) {
+		err = flash_area_write(blob_fa, off + offsetof(struct blob_index_header, magic),
+				       &magic, sizeof(magic));
+	}
+	return err;
+}
+
+static bool blob_entry_live(const struct blob_entry *entry)
+{
+	return entry->magic == BLOB_MAGIC && entry->committed == BLOB_COMMITTED &&
+	       entry->deleted == BLOB_ERASED;
+}
+
+static int blob_entry_mark(int slot, size_t field, uint32_t value)
+{
+	return flash_area_write(blob_fa,
+				blob_index_offset(blob_index_page) + slot * sizeof(struct blob_entry) +
+					field,
+				&value, sizeof(value));
+}
+
+static void blob_info_fill(const struct blob_entry *entry, struct blob_info *info)
+{
+	info->id = entry->id;
+	info->size = entry->size;
+	info->data = blob_base + (BLOB_INDEX_PAGES + entry->first_page) * BLOB_PAGE_SIZE;
+	info->digest = entry->digest;
+}
+
+static int blob_find_slot(uint8_t id)
+{
+	for (int i = 0; i < BLOB_INDEX_ENTRIES && blob_index[i].magic != BLOB_ERASED; i++) {
+		if (blob_index[i].id == id && blob_entry_live(&blob_index[i])) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Pages held by live blobs and the upload in progress */
+static uint32_t blob_pages_used(void)
+{
+	uint32_t used = 0;
+
+	for (int i = 0; i < BLOB_INDEX_ENTRIES && blob_index[i].magic != BLOB_ERASED; i++) {
+		const struct blob_entry *entry = &blob_index[i];
+
+		if (entry->magic == BLOB_MAGIC && entry->deleted == BLOB_ERASED) {
+			used |= GENMASK(entry->first_page + entry->pages - 1, entry->first_page);
+		}
+	}
+	return used;
+}
+
+static int blob_pages_alloc(uint8_t pages)
+{
+	uint32_t used = blob_pages_used();
+
+	for (int first = 0; first + pages <= BLOB_DATA_PAGES; first++) {
+		if (!(used & GENMASK(first + pages - 1, first))) {
+			return first;
+		}
+	}
+	return -1;
+}
+
+/* Copy the live entries to the other index page and switch to it */
+static int blob_index_compact(void)
+{
+	struct blob_entry live[BLOB_DATA_PAGES];
+	uint8_t page = !blob_index_page;
+	int count = 0;
+
+	for (int i = 0; i < BLOB_INDEX_ENTRIES && count < BLOB_DATA_PAGES; i++) {
+		if (blob_entry_live(&blob_index[i])) {
+			live[count++] = blob_index[i];
+		}
+	}
+
+	/* Nobody reads the other page, so the erase runs without blob_lock */
+	int err = flash_area_erase(blob_fa, page * BLOB_PAGE_SIZE, BLOB_PAGE_SIZE);
+
+	if (!err && count) {
+		err = flash_area_write(blob_fa, blob_index_offset(page), live,
+				       count * sizeof(live[0]));
+	}
+	if (!err) {
+		err = blob_index_header_write(page, blob_index_gen + 1);
+	}
+	if (err) {
+		LOG_ERR("Blob index compaction failed: %d", err);
+		return err;
+	}
+
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	blob_index_use(page, blob_index_gen + 1);
+	k_mutex_unlock(&blob_lock);
+	LOG_INF("Blob index compacted to page %d, %d live entries", page, count);
+	return 0;
+}
+
+static int blob_index_claim(void)
+{
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = 0; i < BLOB_INDEX_ENTRIES; i++) {
+			if (blob_index[i].magic == BLOB_ERASED) {
+				return i;
+			}
+		}
+		if (pass == 0 && blob_index_compact()) {
+			break;
+		}
+	}
+	return -1;
+}
+
+static void blob_upload_drop(void)
+{
+	if (blob_upload.state == BLOB_STATE_RECEIVING || blob_upload.state == BLOB_STATE_RECEIVED) {
+		blob_entry_mark(blob_upload.slot, offsetof(struct blob_entry, deleted), 0);
+	}
+	blob_upload.state = BLOB_STATE_IDLE;
+}
+
+static int blob_begin(const uint8_t *data, uint16_t len)
+{
+	if (len != 1 + 1 + 4 + BLOB_DIGEST_LEN) {
+		return -EINVAL;
+	}
+
+	uint8_t id = data[1];
+	uint32_t size = sys_get_le32(&data[2]);
+
+	if (id < BLOB_ID_MIN || id > BLOB_ID_MAX || size == 0) {
+		return -EINVAL;
+	}
+
+	if (size > BLOB_DATA_PAGES * BLOB_PAGE_SIZE) {
+		LOG_ERR("Blob %d too large (%u bytes)", id, size);
+		return -ENOSPC;
+	}
+
+	blob_upload_drop();
+
+	uint8_t pages = DIV_ROUND_UP(size, BLOB_PAGE_SIZE);
+	int first = blob_pages_alloc(pages);
+	int slot = first >= 0 ? blob_index_claim() : -1;
+
+	if (slot < 0) {
+		LOG_ERR("No room for blob %d (%u bytes)", id, size);
+		return -ENOSPC;
+	}
+
+	struct blob_entry entry = {
+		.magic = BLOB_MAGIC,
+		.id = id,
+		.first_page = first,
+		.pages = pages,
+		.reserved = 0xFF,
+		.size = size,
+	};
+
+	memcpy(entry.digest, &data[6], BLOB_DIGEST_LEN);
+
+	/* Claim the pages first so an interrupted upload is reclaimed at boot */
+	int err = flash_area_write(blob_fa, blob_index_offset(blob_index_page) + slot * sizeof(entry),
+				   &entry, offsetof(struct blob_entry, committed));
+
+	if (!err) {
+		err = stream_flash_init(&blob_upload.stream, flash_area_get_device(blob_fa),
+					blob_stream_buf, sizeof(blob_stream_buf),
+					blob_fa->fa_off + (BLOB_INDEX_PAGES + first) * BLOB_PAGE_SIZE,
+					pages * BLOB_PAGE_SIZE, NULL);
+	}
+	if (err) {
+		LOG_ERR("Failed to start blob %d: %d", id, err);
+		return -EIO;
+	}
+
+	blob_upload.state = BLOB_STATE_RECEIVING;
+	blob_upload.id = id;
+	blob_upload.slot = slot;
+	blob_upload.size = size;
+	blob_upload.received = 0;
+	LOG_INF("Receiving blob %d: %u bytes in pages %d-%d", id, size, first, first + pages - 1);
+	return 0;
+}
+
+static int blob_commit(void)
+{
+	if (blob_upload.state != BLOB_STATE_RECEIVED) {
+		return -EACCES;
+	}
+
+	const struct blob_entry *entry = &blob_index[blob_upload.slot];
+	psa_hash_operation_t op = PSA_HASH_OPERATION_INIT;
+	struct blob_info info;
+	uint8_t digest[BLOB_DIGEST_LEN];
+	size_t digest_len;
+
+	blob_info_fill(entry, &info);
+
+	/*
+	 * The CryptoCell DMA cannot read flash, so feed the mapped blob through
+	 * the (now idle) stream buffer.
+	 */
+	psa_status_t status = psa_hash_setup(&op, PSA_ALG_SHA_256);
+
+	for (uint32_t off = 0; status == PSA_SUCCESS && off < info.size;
+	     off += sizeof(blob_stream_buf)) {
+		size_t n = MIN(info.size - off, sizeof(blob_stream_buf));
+
+		memcpy(blob_stream_buf, &info.data[off], n);
+		status = psa_hash_update(&op, blob_stream_buf, n);
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_hash_finish(&op, digest, sizeof(digest), &digest_len);
+	} else {
+		psa_hash_abort(&op);
+	}
+
+	if (status != PSA_SUCCESS || memcmp(digest, entry->digest, BLOB_DIGEST_LEN) != 0) {
+		LOG_ERR("Blob %d digest mismatch (%d)", blob_upload.id, status);
+		blob_upload_drop();
+		blob_upload.state = BLOB_STATE_ERROR;
+		return -EBADMSG;
+	}
+
+	k_mutex_lock(&blob_lock, K_FOREVER);
+
+	int old = blob_find_slot(blob_upload.id);
+	int err = blob_entry_mark(blob_upload.slot, offsetof(struct blob_entry, committed),
+				  BLOB_COMMITTED);
+
+	if (!err && old >= 0) {
+		err = blob_entry_mark(old, offsetof(struct blob_entry, deleted), 0);
+	}
+	k_mutex_unlock(&blob_lock);
+
+	if (err) {
+		blob_upload.state = BLOB_STATE_ERROR;
+		return -EIO;
+	}
+
+	blob_upload.state = BLOB_STATE_COMMITTED;
+	LOG_INF("Blob %d committed (%u bytes)", blob_upload.id, blob_upload.size);
+	return 0;
+}
+
+static int blob_delete(uint8_t id)
+{
+	int slot = blob_find_slot(id);
+	int err = 0;
+
+	if (slot < 0) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	if (blob_transform_id == id) {
+		blob_transform_mode = BLOB_TRANSFORM_NONE;
+	}
+	if (blob_entry_mark(slot, offsetof(struct blob_entry, deleted), 0)) {
+		err = -EIO;
+	}
+	k_mutex_unlock(&blob_lock);
+
+	if (!err) {
+		LOG_INF("Blob %d deleted", id);
+	}
+	return err;
+}
+
+static int blob_select(uint8_t id, uint8_t mode)
+{
+	int slot = blob_find_slot(id);
+
+	switch (mode) {
+	case BLOB_TRANSFORM_NONE:
+		break;
+	case BLOB_TRANSFORM_XOR:
+		if (slot < 0) {
+			return -ENOENT;
+		}
+		break;
+	case BLOB_TRANSFORM_LUT:
+		if (slot < 0) {
+			return -ENOENT;
+		}
+		if (blob_index[slot].size < 256) {
+			return -EINVAL;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	blob_transform_id = id;
+	blob_transform_mode = mode;
+	k_mutex_unlock(&blob_lock);
+	LOG_INF("Data transform: blob %d, mode %d", id, mode);
+	return 0;
+}
+
+/* Release blob_upload_lock, publishing the status it protected */
+static void blob_upload_unlock(void)
+{
+	uint8_t free_pages = blob_fa ? BLOB_DATA_PAGES - __builtin_popcount(blob_pages_used()) : 0;
+	k_spinlock_key_t key = k_spin_lock(&blob_status_lock);
+
+	blob_status[0] = blob_upload.state;
+	blob_status[1] = blob_upload.id;
+	blob_status[2] = (uint8_t)blob_upload.result;
+	sys_put_le16(blob_upload.received, &blob_status[3]);
+	sys_put_le16(blob_upload.size, &blob_status[5]);
+	blob_status[7] = free_pages;
+	blob_status[8] = blob_upload.seq;
+	k_spin_unlock(&blob_status_lock, key);
+
+	k_mutex_unlock(&blob_upload_lock);
+}
+
+int blob_command(const uint8_t *data, uint16_t len)
+{
+	int err;
+
+	if (len < 1) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&blob_upload_lock, K_FOREVER);
+
+	if (!blob_fa) {
+		err = -EIO;
+		goto out;
+	}
+
+	switch (data[0]) {
+	case BLOB_CMD_BEGIN:
+		err = blob_begin(data, len);
+		break;
+
+	case BLOB_CMD_COMMIT:
+		err = blob_commit();
+		break;
+
+	case BLOB_CMD_ABORT:
+		blob_upload_drop();
+		err = 0;
+		break;
+
+	case BLOB_CMD_DELETE:
+		err = len == 2 ? blob_delete(data[1]) : -EINVAL;
+		break;
+
+	case BLOB_CMD_SELECT:
+		err = len == 3 ? blob_select(data[1], data[2]) : -EINVAL;
+		break;
+
+	default:
+		LOG_ERR("Unknown blob command: 0x%02X", data[0]);
+		err = -ENOTSUP;
+		break;
+	}
+
+out:
+	blob_upload.result = err;
+	blob_upload.seq++;
+	blob_upload_unlock();
+	return err;
+}
+
+int blob_write_chunk(const uint8_t *data, uint16_t len)
+{
+	int err = 0;
+
+	k_mutex_lock(&blob_upload_lock, K_FOREVER);
+
+	if (blob_upload.state != BLOB_STATE_RECEIVING) {
+		err = -EACCES;
+		goto out;
+	}
+
+	if (blob_upload.received + len > blob_upload.size) {
+		LOG_ERR("Blob chunk exceeds expected size");
+		blob_upload_drop();
+		blob_upload.state = BLOB_STATE_ERROR;
+		err = -EFBIG;
+		goto out;
+	}
+
+	blob_upload.received += len;
+
+	/* Pages are erased as the stream reaches them; flush with the last chunk */
+	err = stream_flash_buffered_write(&blob_upload.stream, data, len,
+					  blob_upload.received == blob_upload.size);
+	if (err) {
+		LOG_ERR("Failed to write blob chunk: %d", err);
+		blob_upload_drop();
+		blob_upload.state = BLOB_STATE_ERROR;
+		err = -EIO;
+		goto out;
+	}
+
+	if (blob_upload.received == blob_upload.size) {
+		blob_upload.state = BLOB_STATE_RECEIVED;
+	}
+
+out:
+	blob_upload_unlock();
+	return err;
+}
+
+void blob_upload_fail(void)
+{
+	k_mutex_lock(&blob_upload_lock, K_FOREVER);
+	if (blob_upload.state == BLOB_STATE_RECEIVING || blob_upload.state == BLOB_STATE_RECEIVED) {
+		LOG_ERR("Blob %d lost a chunk, upload failed", blob_upload.id);
+		blob_upload_drop();
+		blob_upload.state = BLOB_STATE_ERROR;
+	}
+	blob_upload_unlock();
+}
+
+void blob_status_encode(uint8_t status[BLOB_STATUS_LEN])
+{
+	k_spinlock_key_t key = k_spin_lock(&blob_status_lock);
+
+	memcpy(status, blob_status, BLOB_STATUS_LEN);
+	k_spin_unlock(&blob_status_lock, key);
+}
+
+int blob_find(uint8_t id, struct blob_info *info)
+{
+	int err = -ENOENT;
+
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	int slot = blob_fa ? blob_find_slot(id) : -1;
+
+	if (slot >= 0) {
+		blob_info_fill(&blob_index[slot], info);
+		err = 0;
+	}
+	k_mutex_unlock(&blob_lock);
+	return err;
+}
+
+void blob_foreach(void (*cb)(const struct blob_info *info, void *user_data), void *user_data)
+{
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	for (int i = 0; blob_fa && i < BLOB_INDEX_ENTRIES && blob_index[i].magic != BLOB_ERASED;
+	     i++) {
+		if (blob_entry_live(&blob_index[i])) {
+			struct blob_info info;
+
+			blob_info_fill(&blob_index[i], &info);
+			cb(&info, user_data);
+		}
+	}
+	k_mutex_unlock(&blob_lock);
+}
+
+enum blob_transform blob_transform_acquire(struct blob_info *info)
+{
+	k_mutex_lock(&blob_lock, K_FOREVER);
+
+	if (blob_transform_mode == BLOB_TRANSFORM_NONE) {
+		return BLOB_TRANSFORM_NONE;
+	}
+
+	/* Held until release, so the blob cannot be replaced or erased meanwhile */
+	int slot = blob_find_slot(blob_transform_id);
+
+	if (slot < 0) {
+		return BLOB_TRANSFORM_NONE;
+	}
+	/* A replacement committed since the select may be too short for a table */
+	if (blob_transform_mode == BLOB_TRANSFORM_LUT && blob_index[slot].size < 256) {
+		return BLOB_TRANSFORM_NONE;
+	}
+	blob_info_fill(&blob_index[slot], info);
+	return blob_transform_mode;
+}
+
+void blob_transform_release(void)
+{
+	k_mutex_unlock(&blob_lock);
+}
+
+int blob_store_init(void)
+{
+	const struct flash_area *fa;
+	struct flash_pages_info page;
+
+	int err = flash_area_open(FIXED_PARTITION_ID(storage_partition), &fa);
+
+	if (err) {
+		LOG_ERR("Failed to open storage partition: %d", err);
+		return err;
+	}
+
+	err = flash_get_page_info_by_offs(flash_area_get_device(fa), fa->fa_off, &page);
+	if (err || page.size != BLOB_PAGE_SIZE) {
+		LOG_ERR("Blob store needs %d byte flash pages", BLOB_PAGE_SIZE);
+		flash_area_close(fa);
+		return -ENOTSUP;
+	}
+
+	err = psa_crypto_init();
+	if (err != PSA_SUCCESS) {
+		LOG_ERR("PSA crypto init failed: %d", err);
+		flash_area_close(fa);
+		return -EIO;
+	}
+
+	k_mutex_lock(&blob_upload_lock, K_FOREVER);
+	k_mutex_lock(&blob_lock, K_FOREVER);
+	blob_fa = fa;
+	blob_base = blob_mapped_base();
+
+	/* Use the newer of the valid index pages, or start a fresh index */
+	const struct blob_index_header *hdr[BLOB_INDEX_PAGES] = {
+		(const struct blob_index_header *)blob_base,
+		(const struct blob_index_header *)(blob_base + BLOB_PAGE_SIZE),
+	};
+	bool valid0 = hdr[0]->magic == BLOB_INDEX_MAGIC;
+	bool valid1 = hdr[1]->magic == BLOB_INDEX_MAGIC;
+
+	if (valid0 && (!valid1 || (int32_t)(hdr[0]->generation - hdr[1]->generation) > 0)) {
+		blob_index_use(0, hdr[0]->generation);
+	} else if (valid1) {
+		blob_index_use(1, hdr[1]->generation);
+	} else {
+		err = flash_area_erase(fa, 0, BLOB_PAGE_SIZE);
+		if (!err) {
+			err = blob_index_header_write(0, 0);
+		}
+		if (err) {
+			LOG_ERR("Failed to format the blob index: %d", err);
+			blob_fa = NULL;
+			k_mutex_unlock(&blob_lock);
+			k_mutex_unlock(&blob_upload_lock);
+			flash_area_close(fa);
+			return -EIO;
+		}
+		LOG_INF("Blob index formatted");
+		blob_index_use(0, 0);
+	}
+
+	/* Release the pages of uploads interrupted by a reset */
+	int live = 0;
+
+	for (int i = 0; i < BLOB_INDEX_ENTRIES && blob_index[i].magic != BLOB_ERASED; i++) {
+		if (blob_index[i].magic != BLOB_MAGIC || blob_index[i].deleted != BLOB_ERASED) {
+			continue;
+		}
+		if (blob_index[i].committed != BLOB_COMMITTED) {
+			blob_entry_mark(i, offsetof(struct blob_entry, deleted), 0);
+			continue;
+		}
+		live++;
+	}
+
+	LOG_INF("Blob store: %d blobs, %d of %d pages free", live,
+		BLOB_DATA_PAGES - __builtin_popcount(blob_pages_used()), BLOB_DATA_PAGES);
+	k_mutex_unlock(&blob_lock);
+	blob_upload_unlock();
+	return 0;
+}
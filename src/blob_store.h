@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef BLOB_STORE_H_
+#define BLOB_STORE_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Blob store in storage_partition: lookup tables and calibration data
+ * pushed without a firmware update. The first two pages take turns
+ * holding an append-only index with a SHA-256 digest per blob; each blob
+ * occupies whole pages after them and is read in place through the
+ * memory-mapped flash.
+ *
+ * Uploads run like the firmware chunks: BLOB_CMD_BEGIN, sequential chunks
+ * (pages erased as the stream reaches them), then BLOB_CMD_COMMIT, which
+ * checks the digest before the blob becomes visible. Committing an id
+ * that already exists replaces the old blob.
+ */
+#define BLOB_ID_MIN      1
+#define BLOB_ID_MAX      254
+#define BLOB_DIGEST_LEN  32
+
+/* Blob control commands */
+#define BLOB_CMD_BEGIN   0x01  /* id, size (LE32), SHA-256 digest */
+#define BLOB_CMD_COMMIT  0x02
+#define BLOB_CMD_ABORT   0x03
+#define BLOB_CMD_DELETE  0x04  /* id */
+#define BLOB_CMD_SELECT  0x05  /* id, enum blob_transform */
+
+/* Upload state, first byte of the status record */
+#define BLOB_STATE_IDLE       0x00
+#define BLOB_STATE_RECEIVING  0x01
+#define BLOB_STATE_RECEIVED   0x02
+#define BLOB_STATE_COMMITTED  0x03
+#define BLOB_STATE_ERROR      0xFF
+
+/*
+ * Status record: state, id, result of the last command (negative errno),
+ * received (LE16), size (LE16), free pages, count of handled commands
+ * (wraps at 256)
+ */
+#define BLOB_STATUS_LEN  9
+
+/* How process_data() uses the selected blob on the reversed input */
+enum blob_transform {
+	BLOB_TRANSFORM_NONE,  /* XOR 0xAA */
+	BLOB_TRANSFORM_XOR,   /* XOR with the blob as a repeating key stream */
+	BLOB_TRANSFORM_LUT,   /* 256 byte lookup table */
+};
+
+struct blob_info {
+	uint8_t id;
+	uint32_t size;
+	/* Both point into memory-mapped flash */
+	const uint8_t *data;
+	const uint8_t *digest;
+};
+
+#ifdef CONFIG_PSA_WANT_ALG_SHA_256
+
+int blob_store_init(void);
+
+/*
+ * Returns 0, -EINVAL for a malformed command, -ENOTSUP for an unknown one,
+ * -ENOSPC, -ENOENT, -EACCES when the upload is in the wrong state,
+ * -EBADMSG on a digest mismatch or -EIO
+ */
+int blob_command(const uint8_t *data, uint16_t len);
+
+/* Returns 0, -EACCES when no upload is active, -EFBIG or -EIO */
+int blob_write_chunk(const uint8_t *data, uint16_t len);
+
+/* Fail the upload in progress after a lost chunk, without counting a command */
+void blob_upload_fail(void);
+
+/* Never waits for a running command or chunk */
+void blob_status_encode(uint8_t status[BLOB_STATUS_LEN]);
+
+/* Returns 0 or -ENOENT */
+int blob_find(uint8_t id, struct blob_info *info);
+
+void blob_foreach(void (*cb)(const struct blob_info *info, void *user_data), void *user_data);
+
+/*
+ * The transform blob stays mapped and unchanged from acquire to release,
+ * which must follow every acquire. info is only filled in when the result
+ * is not BLOB_TRANSFORM_NONE.
+ */
+enum blob_transform blob_transform_acquire(struct blob_info *info);
+void blob_transform_release(void);
+
+#else
+
+static inline int blob_store_init(void)
+{
+	return 0;
+}
+
+static inline int blob_command(const uint8_t *data, uint16_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline int blob_write_chunk(const uint8_t *data, uint16_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline void blob_upload_fail(void)
+{
+}
+
+static inline void blob_status_encode(uint8_t status[BLOB_STATUS_LEN])
+{
+	memset(status, 0, BLOB_STATUS_LEN);
+}
+
+static inline int blob_find(uint8_t id, struct blob_info *info)
+{
+	return -ENOENT;
+}
+
+static inline void blob_foreach(void (*cb)(const struct blob_info *info, void *user_data),
+				void *user_data)
+{
+}
+
+static inline enum blob_transform blob_transform_acquire(struct blob_info *info)
+{
+	return BLOB_TRANSFORM_NONE;
+}
+
+static inline void blob_transform_release(void)
+{
+}
+
+#endif /* CONFIG_PSA_WANT_ALG_SHA_256 */
+
+#endif /* BLOB_STORE_H_ */
@@ -11,6 +11,7 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/sys/reboot.h>
+#include <stdlib.h>
 #include <string.h>
 #include <zephyr/dfu/mcuboot.h>
 
@@ -19,6 +20,12 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/uuid.h>
 
+#include "transport.h"
+#include "segment.h"
+#include "ota_crypto.h"
+#include "qos.h"
+#include "blob_store.h"
+
 #ifdef CONFIG_MCUMGR
 #include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
 // #include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>  // Disabled - requires bootutil
@@ -64,11 +71,24 @@ static bool blink_enabled = true;
 #define FIRMWARE_CONTROL_CHAR_UUID \
 	BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x9ABC, 0xDEF01234567D))
 
-/* Buffer for data processing */
+/* Data Segment Input Characteristic UUID: 12345678-1234-5678-9ABC-DEF01234567E */
+#define DATA_SEGMENT_INPUT_CHAR_UUID \
+	BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x9ABC, 0xDEF01234567E))
+
+/* Data Segment Output Characteristic UUID: 12345678-1234-5678-9ABC-DEF01234567F */
+#define DATA_SEGMENT_OUTPUT_CHAR_UUID \
+	BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x9ABC, 0xDEF01234567F))
+
+/* Blob Control Characteristic UUID: 12345678-1234-5678-9ABC-DEF012345680 */
+#define BLOB_CONTROL_CHAR_UUID \
+	BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x9ABC, 0xDEF012345680))
+
+/* Blob Data Characteristic UUID: 12345678-1234-5678-9ABC-DEF012345681 */
+#define BLOB_DATA_CHAR_UUID \
+	BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x12345678, 0x1234, 0x5678, 0x9ABC, 0xDEF012345681))
+
+/* Maximum data payload per Bluetooth write */
 #define MAX_DATA_SIZE 244  // MTU - overhead
-static uint8_t input_data[MAX_DATA_SIZE];
-static uint8_t output_data[MAX_DATA_SIZE];
-static uint16_t data_length = 0;
 
 /* Firmware update buffers and state */
 #define FIRMWARE_CHUNK_SIZE 240  // MTU - overhead for firmware chunks
@@ -78,6 +98,24 @@ static uint32_t firmware_size = 0;
 static uint32_t firmware_received = 0;
 static uint32_t firmware_crc32 = 0;
 static bool firmware_update_active = false;
+/* slot1 is erased page by page as the image reaches it */
+static uint32_t firmware_erased = 0;
+
+/* Serialises the update state machine between the GATT and framed transports */
+K_MUTEX_DEFINE(firmware_lock);
+
+/* Status record as of the last firmware_unlock(), so reads never wait on flash work */
+static struct k_spinlock firmware_snapshot_lock;
+static uint8_t firmware_snapshot[FIRMWARE_STATUS_LEN];
+static bool firmware_snapshot_active;
+
+/*
+ * GATT commands run later on the QoS thread. STARTs are counted when queued
+ * and when run, so the status reads PENDING in between rather than what the
+ * previous session ended in.
+ */
+static atomic_t firmware_starts_queued;
+static atomic_t firmware_starts_run;
 
 /* Firmware update status */
 typedef enum {
@@ -88,6 +126,7 @@ typedef enum {
 	FW_STATUS_VERIFIED = 0x04,
 	FW_STATUS_FLASHING = 0x05,
 	FW_STATUS_COMPLETE = 0x06,
+	FW_STATUS_PENDING = 0x07,
 	FW_STATUS_ERROR = 0xFF
 } firmware_status_t;
 
@@ -101,147 +140,207 @@ static firmware_status_t firmware_status = FW_STATUS_IDLE;
 #define FW_CMD_ABORT 0x05
 #define FW_CMD_SWAP_AND_REBOOT 0x06
 
-/* Forward declaration of the service attributes */
-static const struct bt_gatt_attr *data_output_attr;
-static const struct bt_gatt_attr *firmware_status_attr;
+/* Release firmware_lock, publishing the status it protected */
+static void firmware_unlock(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&firmware_snapshot_lock);
+
+	firmware_snapshot[0] = firmware_status;
+	firmware_snapshot[1] = (firmware_received >> 0) & 0xFF;
+	firmware_snapshot[2] = (firmware_received >> 8) & 0xFF;
+	firmware_snapshot[3] = (firmware_received >> 16) & 0xFF;
+	firmware_snapshot[4] = (firmware_received >> 24) & 0xFF;
+	firmware_snapshot[5] = (firmware_size >> 0) & 0xFF;
+	firmware_snapshot[6] = (firmware_size >> 8) & 0xFF;
+	firmware_snapshot[7] = (firmware_size >> 16) & 0xFF;
+	firmware_snapshot_active = firmware_update_active;
+	k_spin_unlock(&firmware_snapshot_lock, key);
+
+	k_mutex_unlock(&firmware_lock);
+}
 
 /* Reset firmware update state */
 static void firmware_reset(void)
 {
+k_mutex_lock(&firmware_lock, K_FOREVER);
 firmware_size = 0;
 firmware_received = 0;
 firmware_crc32 = 0;
 firmware_update_active = false;
+firmware_erased = 0;
 firmware_status = FW_STATUS_IDLE;
+ota_crypto_stop();
+firmware_unlock();
 LOG_INF("Firmware update state reset");
 }
 
-/* Notify firmware status change */
-static void notify_firmware_status(struct bt_conn *conn)
+/* Produce output bytes [offset, offset + count) of the transform for the whole input */
+void process_data_range(const uint8_t *input, size_t length, size_t offset,
+			uint8_t *output, size_t count)
 {
-    return;
+	/* Example processing: XOR with 0xAA, reverse bytes, add prefix */
+	static const uint8_t prefix[2] = { 0xBE, 0xEF };  // Magic prefix bytes
+	/* A selected blob replaces the 0xAA, read in place from flash */
+	struct blob_info blob;
+	enum blob_transform mode = blob_transform_acquire(&blob);
+
+	for (size_t i = 0; i < count; i++, offset++) {
+		if (offset < sizeof(prefix)) {
+			output[i] = prefix[offset];
+			continue;
+		}
 
-    // The status is polled and notifications don't work.
-	// uint8_t status_data[8];
-	// status_data[0] = firmware_status;
-	// status_data[1] = (firmware_received >> 0) & 0xFF;
-	// status_data[2] = (firmware_received >> 8) & 0xFF;
-	// status_data[3] = (firmware_received >> 16) & 0xFF;
-	// status_data[4] = (firmware_received >> 24) & 0xFF;
-	// status_data[5] = (firmware_size >> 0) & 0xFF;
-	// status_data[6] = (firmware_size >> 8) & 0xFF;
-	// status_data[7] = (firmware_size >> 16) & 0xFF;
-	
-	// int err = bt_gatt_notify(conn, firmware_status_attr, status_data, sizeof(status_data));
-	// if (err) {
-	// 	LOG_ERR("Failed to notify firmware status: %d", err);
-	// }
+		/* Reverse the data, then XOR or look it up */
+		size_t pos = offset - sizeof(prefix);
+		uint8_t byte = input[length - 1 - pos];
+
+		switch (mode) {
+		case BLOB_TRANSFORM_XOR:
+			output[i] = byte ^ blob.data[pos % blob.size];
+			break;
+		case BLOB_TRANSFORM_LUT:
+			output[i] = blob.data[byte];
+			break;
+		default:
+			output[i] = byte ^ 0xAA;
+			break;
+		}
+	}
+
+	blob_transform_release();
 }
 
 /* Function to process/alter the data */
-static void process_data(const uint8_t *input, uint8_t *output, uint16_t length)
+void process_data(const uint8_t *input, uint8_t *output, uint16_t length)
 {
 	LOG_INF("Processing %d bytes of data", length);
 	
-	/* Example processing: XOR with 0xAA, reverse bytes, add prefix */
-	output[0] = 0xBE;  // Magic prefix byte
-	output[1] = 0xEF;  // Magic prefix byte
-	
-	/* Reverse and XOR the data */
-	for (int i = 0; i < length; i++) {
-		output[2 + i] = input[length - 1 - i] ^ 0xAA;
-	}
+	process_data_range(input, length, 0, output, length + 2);
 	
 	LOG_INF("Data processed: input[0]=0x%02X -> output[2]=0x%02X", 
 		   input[0], output[2]);
 }
 
-/* Data Input write callback */
-static ssize_t data_input_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-				const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+/* Erase slot1 up to end, a page at a time, so no single job erases the whole slot */
+static int firmware_erase_to(const struct flash_area *fa, uint32_t end)
 {
-	const uint8_t *data = buf;
-	
-	LOG_INF("Received %d bytes via Bluetooth", len);
-	
-	if (offset + len > MAX_DATA_SIZE) {
-		LOG_ERR("Data too large: %d bytes", offset + len);
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
-	}
-	
-	/* Store input data */
-	memcpy(input_data + offset, data, len);
-	data_length = offset + len;
-	
-	/* Process the data */
-	process_data(input_data, output_data, data_length);
-	
-	/* Send processed data back via notification */
-	int err = bt_gatt_notify(conn, data_output_attr, 
-					 output_data, data_length + 2);  // +2 for prefix
-	if (err) {
-		LOG_ERR("Failed to send notification: %d", err);
-	} else {
-		LOG_INF("Sent %d bytes back to client", data_length + 2);
+	while (firmware_erased < end) {
+		struct flash_pages_info page;
+		int ret = flash_get_page_info_by_offs(flash_area_get_device(fa),
+						      fa->fa_off + firmware_erased, &page);
+
+		if (!ret) {
+			ret = flash_area_erase(fa, page.start_offset - fa->fa_off, page.size);
+		}
+		if (ret) {
+			return ret;
+		}
+		firmware_erased = page.start_offset - fa->fa_off + page.size;
 	}
-	
-	return len;
+
+	return 0;
 }
 
-/* Data Output read callback */
-static ssize_t data_output_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-				void *buf, uint16_t len, uint16_t offset)
+/*
+ * Erase the last page of slot1, which holds the MCUboot image trailer. The
+ * image never reaches it, so firmware_erase_to() would leave the previous
+ * update's swap state in place for boot_request_upgrade().
+ */
+static int firmware_erase_trailer(const struct flash_area *fa)
 {
-	LOG_INF("Client reading output data");
-	
-	if (offset > data_length + 2) {
-		return 0;
+	struct flash_pages_info page;
+	int ret = flash_get_page_info_by_offs(flash_area_get_device(fa),
+					      fa->fa_off + fa->fa_size - 1, &page);
+
+	if (!ret) {
+		ret = flash_area_erase(fa, page.start_offset - fa->fa_off, page.size);
 	}
-	
-	return bt_gatt_attr_read(conn, attr, buf, len, offset, 
-				 output_data, data_length + 2);
+	return ret;
 }
 
-/* CCC (Client Characteristic Configuration) callback for notifications */
-static void data_output_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+/* Decrypt an encrypted image chunk piece by piece into slot1 at firmware_received */
+static int firmware_write_decrypted(const struct flash_area *fa, const uint8_t *data, uint16_t len)
 {
-	bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
-	LOG_INF("Data output notifications %s", notif_enabled ? "enabled" : "disabled");
+	/* Only used with firmware_lock held */
+	static uint8_t plain[OTA_CRYPTO_BLOCK_MAX];
+
+	for (uint16_t done = 0; done < len;) {
+		uint16_t count = MIN(len - done, sizeof(plain));
+		uint32_t offset = firmware_received + done;
+		int ret = ota_crypto_decrypt(offset, &data[done], plain, count);
+
+		if (ret) {
+			return ret;
+		}
+
+		/* Pad the image tail up to the flash word size */
+		uint16_t aligned = ROUND_UP(count, 4);
+
+		memset(&plain[count], 0xFF, aligned - count);
+		ret = flash_area_write(fa, offset, plain, aligned);
+		if (ret) {
+			return ret;
+		}
+		done += count;
+	}
+
+	return 0;
 }
 
-/* Firmware Update write callback - receives firmware chunks */
-static ssize_t firmware_update_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-					 const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+/* Append a firmware chunk to slot1 - shared by the GATT and framed transports */
+int firmware_write_chunk(const uint8_t *data, uint16_t len)
 {
-	const uint8_t *data = buf;
-	
+	int ret;
+
+	k_mutex_lock(&firmware_lock, K_FOREVER);
+
 	if (!firmware_update_active) {
 		LOG_ERR("Firmware update not active");
-		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+		ret = -EACCES;
+		goto out;
 	}
 
 	if (firmware_received + len > firmware_size) {
 		LOG_ERR("Firmware chunk exceeds expected size");
 		firmware_status = FW_STATUS_ERROR;
-		notify_firmware_status(conn);
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+		ret = -EFBIG;
+		goto out;
 	}
 
 	/* Write chunk directly to flash */
 	const struct flash_area *fa;
-	int ret = flash_area_open(FIXED_PARTITION_ID(slot1_partition), &fa);
+	ret = flash_area_open(FIXED_PARTITION_ID(slot1_partition), &fa);
 	if (ret) {
 		LOG_ERR("Failed to open flash area: %d", ret);
 		firmware_status = FW_STATUS_ERROR;
-		notify_firmware_status(conn);
-		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+		ret = -EIO;
+		goto out;
+	}
+
+	/* Erase the pages this chunk reaches */
+	ret = firmware_erase_to(fa, MIN(firmware_received + ROUND_UP(len, 4), fa->fa_size));
+	if (ret) {
+		LOG_ERR("Failed to erase slot1 at %u: %d", firmware_erased, ret);
+		flash_area_close(fa);
+		firmware_status = FW_STATUS_ERROR;
+		ret = -EIO;
+		goto out;
 	}
 
 	/* Write chunk at current offset */
-    if (firmware_received + len >= firmware_size && len % 4 != 0) {
-        // Write a few bytes to align to 4-byte boundary only if the file is finished.
-        uint16_t tmp = 4*((len / 4)+1);
-        ret = flash_area_write(fa, firmware_received, data, tmp);
+    if (ota_crypto_active()) {
+        ret = firmware_write_decrypted(fa, data, len);
+    } else if (firmware_received + len >= firmware_size && len % 4 != 0) {
+        /* Pad the image tail to the flash word size in a local word, not past data */
+        uint16_t aligned = ROUND_DOWN(len, 4);
+        uint8_t tail[4];
+
+        ret = aligned ? flash_area_write(fa, firmware_received, data, aligned) : 0;
+        if (!ret) {
+            memset(tail, 0xFF, sizeof(tail));
+            memcpy(tail, &data[aligned], len - aligned);
+            ret = flash_area_write(fa, firmware_received + aligned, tail, sizeof(tail));
+        }
     } else {
 	    ret = flash_area_write(fa, firmware_received, data, len);
     }
@@ -249,8 +348,8 @@ static ssize_t firmware_update_write(struct bt_conn *conn, const struct bt_gatt_
 	if (ret) {
 		LOG_ERR("Failed to write chunk to flash: %d", ret);
 		firmware_status = FW_STATUS_ERROR;
-		notify_firmware_status(conn);
-		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+		ret = -EIO;
+		goto out;
 	}
 
 	firmware_received += len;
@@ -263,48 +362,87 @@ static ssize_t firmware_update_write(struct bt_conn *conn, const struct bt_gatt_
 	if (firmware_received >= firmware_size) {
 		firmware_status = FW_STATUS_RECEIVED;
 		LOG_INF("Firmware completely received: %d bytes", firmware_received);
+
+		if (ota_crypto_active()) {
+			struct ota_crypto_stats stats;
+
+			ota_crypto_stats_get(&stats);
+			uint32_t usec = k_cyc_to_us_floor32(stats.cycles);
+
+			LOG_INF("Decrypted %u bytes in %u us (%u KB/s)", stats.bytes, usec,
+				usec ? (uint32_t)((uint64_t)stats.bytes * 1000000 / usec / 1024) : 0);
+		}
 	}
 
-	notify_firmware_status(conn);
-	return len;
+out:
+	firmware_unlock();
+	return ret;
 }
 
-/* Firmware Status read callback */
-static ssize_t firmware_status_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-					void *buf, uint16_t len, uint16_t offset)
+/*
+ * The 8-byte status record: status, received (LE32), expected size (LE24).
+ * Read from the snapshot, so it never waits for a running flash operation.
+ */
+void firmware_status_encode(uint8_t status_data[FIRMWARE_STATUS_LEN])
 {
-	uint8_t status_data[8];
-	status_data[0] = firmware_status;
-	status_data[1] = (firmware_received >> 0) & 0xFF;
-	status_data[2] = (firmware_received >> 8) & 0xFF;
-	status_data[3] = (firmware_received >> 16) & 0xFF;
-	status_data[4] = (firmware_received >> 24) & 0xFF;
-	status_data[5] = (firmware_size >> 0) & 0xFF;
-	status_data[6] = (firmware_size >> 8) & 0xFF;
-	status_data[7] = (firmware_size >> 16) & 0xFF;
-	
-	return bt_gatt_attr_read(conn, attr, buf, len, offset, status_data, sizeof(status_data));
+	k_spinlock_key_t key = k_spin_lock(&firmware_snapshot_lock);
+
+	memcpy(status_data, firmware_snapshot, FIRMWARE_STATUS_LEN);
+	k_spin_unlock(&firmware_snapshot_lock, key);
+
+	if (atomic_get(&firmware_starts_queued) != atomic_get(&firmware_starts_run)) {
+		status_data[0] = FW_STATUS_PENDING;
+	}
 }
 
-/* Firmware Control write callback - handles commands */
-static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
-					  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+/* Check a firmware control command's opcode and length without running it */
+static int firmware_command_check(const uint8_t *data, uint16_t len)
 {
-	const uint8_t *data = buf;
-	
 	if (len < 1) {
-		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+		return -EINVAL;
 	}
-	
-	uint8_t command = data[0];
-	
-	switch (command) {
+
+	switch (data[0]) {
 	case FW_CMD_START:
 		if (len < 5) {
 			LOG_ERR("FW_CMD_START requires 5 bytes (cmd + size)");
-			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+			return -EINVAL;
 		}
+		/* Encrypted images append the initial AES-CTR counter block */
+		if (len > 5 && len != 5 + OTA_CRYPTO_IV_LEN) {
+			LOG_ERR("FW_CMD_START takes 5 or %d bytes", 5 + OTA_CRYPTO_IV_LEN);
+			return -EINVAL;
+		}
+		return 0;
 
+	case FW_CMD_RESET:
+	case FW_CMD_VERIFY:
+	case FW_CMD_FLASH:
+	case FW_CMD_ABORT:
+	case FW_CMD_SWAP_AND_REBOOT:
+		return 0;
+
+	default:
+		LOG_ERR("Unknown firmware command: 0x%02X", data[0]);
+		return -ENOTSUP;
+	}
+}
+
+/* Run a firmware control command - shared by the GATT and framed transports */
+int firmware_command(const uint8_t *data, uint16_t len)
+{
+	int err = firmware_command_check(data, len);
+
+	if (err) {
+		return err;
+	}
+	
+	uint8_t command = data[0];
+	
+	k_mutex_lock(&firmware_lock, K_FOREVER);
+
+	switch (command) {
+	case FW_CMD_START: {
 		uint32_t new_firmware_size = (data[1] << 0) | (data[2] << 8) | (data[3] << 16) | (data[4] << 24);
 		/* Check partition size */
 		const struct flash_area *fa;
@@ -319,15 +457,25 @@ static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt
 			firmware_update_active = true;
 			firmware_status = FW_STATUS_RECEIVING;
 			LOG_INF("Firmware update started, expecting %d bytes", firmware_size);
-			/* Erase partition before writing */
-			ret = flash_area_erase(fa, 0, fa->fa_size);
-			flash_area_close(fa);
+			if (len == 5 + OTA_CRYPTO_IV_LEN && ota_crypto_start(&data[5])) {
+				LOG_ERR("Encrypted image refused");
+				firmware_update_active = false;
+				firmware_status = FW_STATUS_ERROR;
+				flash_area_close(fa);
+				break;
+			}
+			/* Pages are erased by the chunks that reach them, the trailer here */
+			ret = firmware_erase_trailer(fa);
 			if (ret) {
-				LOG_ERR("Failed to erase partition: %d", ret);
+				LOG_ERR("Failed to erase the slot1 trailer: %d", ret);
+				ota_crypto_stop();
+				firmware_update_active = false;
 				firmware_status = FW_STATUS_ERROR;
 			}
+			flash_area_close(fa);
 		}
 		break;
+	}
 
 	case FW_CMD_VERIFY:
 		if (firmware_status != FW_STATUS_RECEIVED) {
@@ -367,6 +515,8 @@ static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt
 					}
 				}
 				offset += chunk;
+				/* The read-back takes a while, let queued data jobs through */
+				qos_yield();
 			}
 			flash_area_close(fa);
 			uint32_t calculated_crc = ~crc;
@@ -392,7 +542,6 @@ static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt
 			firmware_status = FW_STATUS_ERROR;
 		} else {
 			firmware_status = FW_STATUS_FLASHING;
-			notify_firmware_status(conn);
 			LOG_INF("Firmware already written to secondary partition during transfer.");
 			firmware_status = FW_STATUS_COMPLETE;
 			LOG_INF("Firmware update marked complete. Ready to swap and reboot.");
@@ -424,12 +573,16 @@ static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt
 				flash_area_close(fa);
 				LOG_INF("System rebooting to apply new firmware...");
 
+#ifdef CONFIG_MCUBOOT_IMG_MANAGER
                 int rc = boot_request_upgrade(0); // Test the new image if it boots it get confirmed.
                 if (rc != 0) {
                     LOG_ERR("Failed to set slot1 image as pending: %d", rc);
                 } else {
                     LOG_INF("Slot1 image marked as pending for swap");
                 }                
+#else
+				LOG_WRN("No bootloader in this build - slot1 left as is");
+#endif
 				
 				/* Give some time for the log message to be sent */
 				k_msleep(500);
@@ -444,14 +597,288 @@ static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt
 		break;
 		
 	default:
-		LOG_ERR("Unknown firmware command: 0x%02X", command);
-		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+		break;
+	}
+	
+	firmware_unlock();
+	return err;
+}
+
+#ifdef CONFIG_BT
+/* Buffer for data processing */
+static uint8_t input_data[MAX_DATA_SIZE];
+static uint8_t output_data[MAX_DATA_SIZE];
+static uint16_t data_length = 0;
+
+/* Forward declaration of the service attributes */
+static const struct bt_gatt_attr *data_output_attr;
+static const struct bt_gatt_attr *firmware_status_attr;
+
+/* Notify firmware status change */
+static void notify_firmware_status(struct bt_conn *conn)
+{
+    return;
+
+    // The status is polled and notifications don't work.
+	// uint8_t status_data[8];
+	// status_data[0] = firmware_status;
+	// status_data[1] = (firmware_received >> 0) & 0xFF;
+	// status_data[2] = (firmware_received >> 8) & 0xFF;
+	// status_data[3] = (firmware_received >> 16) & 0xFF;
+	// status_data[4] = (firmware_received >> 24) & 0xFF;
+	// status_data[5] = (firmware_size >> 0) & 0xFF;
+	// status_data[6] = (firmware_size >> 8) & 0xFF;
+	// status_data[7] = (firmware_size >> 16) & 0xFF;
+	
+	// int err = bt_gatt_notify(conn, firmware_status_attr, status_data, sizeof(status_data));
+	// if (err) {
+	// 	LOG_ERR("Failed to notify firmware status: %d", err);
+	// }
+}
+
+/* QoS jobs - run on the scheduler thread, data class before OTA class */
+static void data_notify_job(struct qos_job *job)
+{
+	int err = bt_gatt_notify(job->conn, data_output_attr, job->data, job->len);
+	if (err) {
+		LOG_ERR("Failed to send notification: %d", err);
+	} else {
+		LOG_INF("Sent %d bytes back to client", job->len);
+	}
+}
+
+/*
+ * Set when the OTA queue was full for a chunk written without response, to
+ * the count of STARTs queued before it plus one. The jobs of that session
+ * then fail it in order, as a lost chunk would shift every later one.
+ */
+static atomic_t firmware_chunk_lost;
+
+static void firmware_check_lost(void)
+{
+	atomic_val_t lost = atomic_get(&firmware_chunk_lost);
+
+	if (!lost || lost - 1 != atomic_get(&firmware_starts_run)) {
+		return;
+	}
+
+	atomic_clear(&firmware_chunk_lost);
+	k_mutex_lock(&firmware_lock, K_FOREVER);
+	if (firmware_update_active) {
+		LOG_ERR("Firmware chunk was dropped, failing the update");
+		firmware_update_active = false;
+		firmware_status = FW_STATUS_ERROR;
+	}
+	firmware_unlock();
+}
+
+static void firmware_chunk_job(struct qos_job *job)
+{
+	firmware_check_lost();
+	firmware_write_chunk(job->data, job->len);
+	notify_firmware_status(job->conn);
+}
+
+static void firmware_control_job(struct qos_job *job)
+{
+	int err;
+
+	if (job->data[0] == FW_CMD_START) {
+		err = firmware_command(job->data, job->len);
+		atomic_inc(&firmware_starts_run);
+	} else {
+		firmware_check_lost();
+		err = firmware_command(job->data, job->len);
+	}
+	if (err) {
+		LOG_ERR("Firmware command 0x%02X failed: %d", job->data[0], err);
+	}
+	notify_firmware_status(job->conn);
+}
+
+/* The same for blob chunks, with BEGIN counted in place of START */
+static atomic_t blob_begins_queued;
+static atomic_t blob_begins_run;
+static atomic_t blob_chunk_lost;
+
+static void blob_check_lost(void)
+{
+	atomic_val_t lost = atomic_get(&blob_chunk_lost);
+
+	if (lost && lost - 1 == atomic_get(&blob_begins_run)) {
+		atomic_clear(&blob_chunk_lost);
+		blob_upload_fail();
+	}
+}
+
+static void blob_chunk_job(struct qos_job *job)
+{
+	blob_check_lost();
+
+	int err = blob_write_chunk(job->data, job->len);
+	if (err) {
+		LOG_ERR("Blob chunk failed: %d", err);
+	}
+}
+
+static void blob_control_job(struct qos_job *job)
+{
+	int err;
+
+	if (job->data[0] == BLOB_CMD_BEGIN) {
+		err = blob_command(job->data, job->len);
+		atomic_inc(&blob_begins_run);
+	} else {
+		blob_check_lost();
+		err = blob_command(job->data, job->len);
+	}
+	if (err) {
+		LOG_ERR("Blob command 0x%02X failed: %d", job->data[0], err);
 	}
+}
+
+/*
+ * Queue an OTA job without waiting - this runs in the Bluetooth RX thread.
+ * Returns -ENOMEM while the OTA queue is full; writes with response hand
+ * that back to the client, which retries.
+ */
+static int ota_job_submit(struct bt_conn *conn, const void *buf, uint16_t len,
+			  qos_handler_t handler)
+{
+	if (len > QOS_JOB_DATA_MAX) {
+		return -EMSGSIZE;
+	}
+
+	struct qos_job *job = qos_job_alloc(QOS_CLASS_OTA, conn, K_NO_WAIT);
+	if (!job) {
+		return -ENOMEM;
+	}
+
+	memcpy(job->data, buf, len);
+	job->len = len;
+	qos_submit(job, handler);
+	return 0;
+}
+
+/* Data Input write callback */
+static ssize_t data_input_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	const uint8_t *data = buf;
+
+	LOG_INF("Received %d bytes via Bluetooth", len);
+	
+	if (offset + len > MAX_DATA_SIZE) {
+		LOG_ERR("Data too large: %d bytes", offset + len);
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+	
+	/* Store input data */
+	memcpy(input_data + offset, data, len);
+	data_length = offset + len;
+	
+	/* Process the data */
+	process_data(input_data, output_data, data_length);
+	
+	/* Send processed data back via notification, ahead of any OTA work */
+	struct qos_job *job = qos_job_alloc(QOS_CLASS_DATA, conn, K_NO_WAIT);
+	if (!job) {
+		LOG_WRN("Data notification queue full, dropping reply");
+		return len;
+	}
+	memcpy(job->data, output_data, data_length + 2);  // +2 for prefix
+	job->len = data_length + 2;
+	qos_submit(job, data_notify_job);
 	
-	notify_firmware_status(conn);
 	return len;
 }
 
+/* Data Output read callback */
+static ssize_t data_output_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				void *buf, uint16_t len, uint16_t offset)
+{
+	LOG_INF("Client reading output data");
+	
+	if (offset > data_length + 2) {
+		return 0;
+	}
+	
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, 
+				 output_data, data_length + 2);
+}
+
+/* CCC (Client Characteristic Configuration) callback for notifications */
+static void data_output_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_INF("Data output notifications %s", notif_enabled ? "enabled" : "disabled");
+}
+
+/* Firmware Update write callback - receives firmware chunks */
+static ssize_t firmware_update_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+					 const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	/* Flash errors show up in the firmware status once the job has run */
+	int ret = ota_job_submit(conn, buf, len, firmware_chunk_job);
+
+	switch (ret) {
+	case 0:
+		return len;
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	default:
+		/* A write with response is retried by the client, a command is lost */
+		if (flags & BT_GATT_WRITE_FLAG_CMD) {
+			LOG_ERR("OTA queue full, dropping firmware chunk");
+			atomic_set(&firmware_chunk_lost, atomic_get(&firmware_starts_queued) + 1);
+		}
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+}
+
+/* Firmware Status read callback */
+static ssize_t firmware_status_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+					void *buf, uint16_t len, uint16_t offset)
+{
+	uint8_t status_data[FIRMWARE_STATUS_LEN];
+
+	firmware_status_encode(status_data);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, status_data, sizeof(status_data));
+}
+
+/* Firmware Control write callback - handles commands */
+static ssize_t firmware_control_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+					  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	int err = firmware_command_check(buf, len);
+	bool start = !err && ((const uint8_t *)buf)[0] == FW_CMD_START;
+
+	/* Counted before it is queued, so a status read right after sees PENDING */
+	if (start) {
+		atomic_inc(&firmware_starts_queued);
+	}
+
+	/* Queued behind the chunks written before it, so VERIFY sees all of them */
+	if (!err) {
+		err = ota_job_submit(conn, buf, len, firmware_control_job);
+	}
+	if (start && err) {
+		atomic_dec(&firmware_starts_queued);
+	}
+
+	switch (err) {
+	case 0:
+		return len;
+	case -EINVAL:
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	case -ENOMEM:
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+	}
+}
+
 /* Firmware Status CCC callback */
 static void firmware_status_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
 {
@@ -459,6 +886,90 @@ static void firmware_status_ccc_changed(const struct bt_gatt_attr *attr, uint16_
 	LOG_INF("Firmware status notifications %s", notif_enabled ? "enabled" : "disabled");
 }
 
+/* Data Segment Input write callback - one segment of a large message */
+static ssize_t data_segment_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	int err = segment_receive(conn, buf, len);
+
+	switch (err) {
+	case 0:
+		return len;
+	case -EINVAL:
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+}
+
+/* Data Segment Output CCC callback */
+static void data_segment_ccc_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	bool notif_enabled = (value == BT_GATT_CCC_NOTIFY);
+	LOG_INF("Data segment notifications %s", notif_enabled ? "enabled" : "disabled");
+}
+
+/* Blob Data write callback - sequential blob chunks, queued like firmware chunks */
+static ssize_t blob_data_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			       const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	/* Write errors show up in the blob status once the job has run */
+	int ret = ota_job_submit(conn, buf, len, blob_chunk_job);
+
+	switch (ret) {
+	case 0:
+		return len;
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	default:
+		/* The upload fails in order with the queued jobs, not from here */
+		if (flags & BT_GATT_WRITE_FLAG_CMD) {
+			LOG_ERR("OTA queue full, dropping blob chunk");
+			atomic_set(&blob_chunk_lost, atomic_get(&blob_begins_queued) + 1);
+		}
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+}
+
+/* Blob Control write callback - commands run in order with the queued chunks */
+static ssize_t blob_control_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	bool begin = len && ((const uint8_t *)buf)[0] == BLOB_CMD_BEGIN;
+
+	if (begin) {
+		atomic_inc(&blob_begins_queued);
+	}
+
+	int err = len ? ota_job_submit(conn, buf, len, blob_control_job) : -EINVAL;
+
+	if (begin && err) {
+		atomic_dec(&blob_begins_queued);
+	}
+
+	switch (err) {
+	case 0:
+		return len;
+	case -EINVAL:
+	case -EMSGSIZE:
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	}
+}
+
+/* Blob Control read callback - status of the last upload and command */
+static ssize_t blob_control_read(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				 void *buf, uint16_t len, uint16_t offset)
+{
+	uint8_t status[BLOB_STATUS_LEN];
+
+	blob_status_encode(status);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, status, sizeof(status));
+}
+
 /* Define the Data Stream GATT Service with Firmware Update */
 BT_GATT_SERVICE_DEFINE(data_stream_service,
 	/* Service Declaration */
@@ -499,6 +1010,33 @@ BT_GATT_SERVICE_DEFINE(data_stream_service,
 				   BT_GATT_CHRC_WRITE,
 				   BT_GATT_PERM_WRITE,
 				   NULL, firmware_control_write, NULL),
+	
+	/* Data Segment Input Characteristic - Write Only (messages up to 4 KB) */
+	BT_GATT_CHARACTERISTIC(DATA_SEGMENT_INPUT_CHAR_UUID,
+				   BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+				   BT_GATT_PERM_WRITE,
+				   NULL, data_segment_write, NULL),
+	
+	/* Data Segment Output Characteristic - Notify Only */
+	BT_GATT_CHARACTERISTIC(DATA_SEGMENT_OUTPUT_CHAR_UUID,
+				   BT_GATT_CHRC_NOTIFY,
+				   BT_GATT_PERM_NONE,
+				   NULL, NULL, NULL),
+	
+	/* CCC Descriptor for data segment notifications */
+	BT_GATT_CCC(data_segment_ccc_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	
+	/* Blob Control Characteristic - Write (commands) + Read (status) */
+	BT_GATT_CHARACTERISTIC(BLOB_CONTROL_CHAR_UUID,
+				   BT_GATT_CHRC_WRITE | BT_GATT_CHRC_READ,
+				   BT_GATT_PERM_WRITE | BT_GATT_PERM_READ,
+				   blob_control_read, blob_control_write, NULL),
+	
+	/* Blob Data Characteristic - Write Only (blob chunks) */
+	BT_GATT_CHARACTERISTIC(BLOB_DATA_CHAR_UUID,
+				   BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
+				   BT_GATT_PERM_WRITE,
+				   NULL, blob_data_write, NULL),
 );
 
 /* Initialize the output attribute pointers after service definition */
@@ -508,6 +1046,8 @@ static void init_gatt_service(void)
 	data_output_attr = &data_stream_service.attrs[3];
 	/* The firmware status characteristic is at index 7 in the service attributes */
 	firmware_status_attr = &data_stream_service.attrs[7];
+	/* The data segment output characteristic is at index 15 in the service attributes */
+	segment_init(&data_stream_service.attrs[15]);
 }
 
 /* Bluetooth advertising data */
@@ -566,7 +1106,7 @@ static void bt_ready_cb(int err)
 	LOG_INF("Advertising successfully started");
 	printk("Bluetooth advertising started as '%s'\n", CONFIG_BT_DEVICE_NAME);
 }
-
+#endif /* CONFIG_BT */
 
 /* Shell command to control LED */
 static int cmd_led_on(const struct shell *sh, size_t argc, char **argv)
@@ -727,6 +1267,165 @@ static int cmd_firmware_reset(const struct shell *sh, size_t argc, char **argv)
 	return 0;
 }
 
+#ifdef CONFIG_BT
+/* Shell command to show per-class scheduler latency */
+static int cmd_qos_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	static const char *const names[QOS_CLASS_COUNT] = { "data", "ota" };
+	uint8_t share;
+	uint16_t budget;
+
+	qos_config_get(&share, &budget);
+	shell_print(sh, "=== QoS Scheduler ===");
+	shell_print(sh, "OTA share: %d%%, data latency budget: %d ms", share, budget);
+
+	for (int cls = 0; cls < QOS_CLASS_COUNT; cls++) {
+		struct qos_class_stats stats;
+
+		qos_stats_get(cls, &stats);
+		shell_print(sh, "%-4s jobs %u, dropped %u, latency avg %u us max %u us, service avg %u us",
+			    names[cls], stats.jobs, stats.dropped, stats.latency_avg_us,
+			    stats.latency_max_us, stats.service_avg_us);
+	}
+
+	struct qos_class_stats data;
+
+	qos_stats_get(QOS_CLASS_DATA, &data);
+	shell_print(sh, "Data jobs over budget: %u", data.over_budget);
+	return 0;
+}
+
+/* Shell command to clear the scheduler statistics */
+static int cmd_qos_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	qos_stats_reset();
+	shell_print(sh, "QoS statistics cleared");
+	return 0;
+}
+
+/* Shell command to tune the scheduler: qos set <ota_share_pct> <data_budget_ms> */
+static int cmd_qos_set(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+
+	int err = qos_config_set(strtoul(argv[1], NULL, 0), strtoul(argv[2], NULL, 0));
+
+	if (err) {
+		shell_error(sh, "OTA share must be 1-100 %% and the budget at least 1 ms");
+		return err;
+	}
+	shell_print(sh, "OTA share %s%%, data latency budget %s ms", argv[1], argv[2]);
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_PSA_WANT_ALG_SHA_256
+static void blob_list_print(const struct blob_info *info, void *user_data)
+{
+	const struct shell *sh = user_data;
+
+	shell_print(sh, "%3d %6u bytes at %p, sha256 %02x%02x%02x%02x...", info->id, info->size,
+		    (void *)info->data, info->digest[0], info->digest[1], info->digest[2],
+		    info->digest[3]);
+}
+
+/* Shell command to list the committed blobs */
+static int cmd_blob_list(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	uint8_t status[BLOB_STATUS_LEN];
+
+	blob_status_encode(status);
+	shell_print(sh, "=== Blob Store ===");
+	blob_foreach(blob_list_print, (void *)sh);
+	shell_print(sh, "Free pages: %d", status[7]);
+	return 0;
+}
+
+/* Shell command to delete a blob: blob delete <id> */
+static int cmd_blob_delete(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+
+	uint8_t cmd[] = { BLOB_CMD_DELETE, strtoul(argv[1], NULL, 0) };
+	int err = blob_command(cmd, sizeof(cmd));
+
+	if (err) {
+		shell_error(sh, "Failed to delete blob %s: %d", argv[1], err);
+		return err;
+	}
+	shell_print(sh, "Blob %s deleted", argv[1]);
+	return 0;
+}
+
+/* Shell command to pick the process_data transform: blob select <id> none|xor|lut */
+static int cmd_blob_select(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+
+	static const char *const modes[] = { "none", "xor", "lut" };
+	uint8_t cmd[] = { BLOB_CMD_SELECT, strtoul(argv[1], NULL, 0), ARRAY_SIZE(modes) };
+
+	for (size_t i = 0; i < ARRAY_SIZE(modes); i++) {
+		if (strcmp(argv[2], modes[i]) == 0) {
+			cmd[2] = i;
+		}
+	}
+
+	int err = blob_command(cmd, sizeof(cmd));
+
+	if (err) {
+		shell_error(sh, "Failed to select blob %s as %s: %d", argv[1], argv[2], err);
+		return err;
+	}
+	shell_print(sh, "Data transform: blob %s, %s", argv[1], argv[2]);
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_PSA_WANT_ALG_CTR
+/* Shell command to time the encrypted image decryption path */
+static int cmd_ota_crypto_bench(const struct shell *sh, size_t argc, char **argv)
+{
+	static const uint8_t iv[OTA_CRYPTO_IV_LEN];
+	uint8_t chunk[FIRMWARE_CHUNK_SIZE];
+	uint32_t total = (argc > 1 ? strtoul(argv[1], NULL, 0) : 64) * 1024;
+	struct ota_crypto_stats stats;
+
+	k_mutex_lock(&firmware_lock, K_FOREVER);
+	if (firmware_update_active || ota_crypto_start(iv)) {
+		firmware_unlock();
+		shell_error(sh, "Decryption busy or unavailable");
+		return -EBUSY;
+	}
+
+	memset(chunk, 0x5A, sizeof(chunk));
+	for (uint32_t offset = 0; offset < total; offset += sizeof(chunk)) {
+		ota_crypto_decrypt(offset, chunk, chunk, MIN(sizeof(chunk), total - offset));
+	}
+	ota_crypto_stats_get(&stats);
+	ota_crypto_stop();
+	firmware_unlock();
+
+	uint32_t usec = MAX(k_cyc_to_us_floor32(stats.cycles), 1);
+
+	shell_print(sh, "Decrypted %u bytes in %u us", stats.bytes, usec);
+	shell_print(sh, "%u KB/s, %u us per %d byte chunk",
+		    (uint32_t)((uint64_t)stats.bytes * 1000000 / usec / 1024),
+		    (uint32_t)((uint64_t)usec * FIRMWARE_CHUNK_SIZE / MAX(stats.bytes, 1)),
+		    FIRMWARE_CHUNK_SIZE);
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_MCUMGR
 /* Shell command to show firmware version and OTA status */
 static int cmd_ota_status(const struct shell *sh, size_t argc, char **argv)
@@ -783,6 +1482,31 @@ SHELL_CMD_REGISTER(test_data, NULL, "Test data processing algorithm", cmd_test_d
 SHELL_CMD_REGISTER(mcumgr_status, NULL, "Show MCUmgr configuration status", cmd_mcumgr_status);
 SHELL_CMD_REGISTER(firmware_status, NULL, "Show firmware update status", cmd_firmware_status);
 SHELL_CMD_REGISTER(firmware_reset, NULL, "Reset firmware update state", cmd_firmware_reset);
+#ifdef CONFIG_BT
+SHELL_STATIC_SUBCMD_SET_CREATE(qos_cmds,
+	SHELL_CMD(stats, NULL, "Show per-class latency statistics", cmd_qos_stats),
+	SHELL_CMD(reset, NULL, "Clear latency statistics", cmd_qos_reset),
+	SHELL_CMD_ARG(set, NULL, "Set <ota_share_pct> <data_budget_ms>", cmd_qos_set, 3, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(qos, &qos_cmds, "Data/OTA scheduler commands", NULL);
+#endif
+#ifdef CONFIG_PSA_WANT_ALG_SHA_256
+SHELL_STATIC_SUBCMD_SET_CREATE(blob_cmds,
+	SHELL_CMD(list, NULL, "List stored blobs", cmd_blob_list),
+	SHELL_CMD_ARG(delete, NULL, "Delete <id>", cmd_blob_delete, 2, 0),
+	SHELL_CMD_ARG(select, NULL, "Use <id> none|xor|lut in process_data", cmd_blob_select,
+		      3, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(blob, &blob_cmds, "Blob store commands", NULL);
+#endif
+#ifdef CONFIG_PSA_WANT_ALG_CTR
+SHELL_CMD_ARG_REGISTER(ota_crypto_bench, NULL, "Time OTA image decryption [KB, default 64]",
+		       cmd_ota_crypto_bench, 1, 1);
+#endif
 #ifdef CONFIG_MCUMGR
 SHELL_CMD_REGISTER(ota_status, NULL, "Show OTA update status and commands", cmd_ota_status);
 #endif
@@ -805,6 +1529,11 @@ int main(void)
 
 	LOG_INF("LED configured successfully");
 
+	ret = blob_store_init();
+	if (ret) {
+		LOG_WRN("Blob store unavailable (err %d)", ret);
+	}
+
 #ifdef CONFIG_MCUMGR
 	/* Initialize MCUmgr subsystem */
 	// img_mgmt_register_group();  // Disabled - requires bootutil
@@ -812,6 +1541,7 @@ int main(void)
 	LOG_INF("MCUmgr OS management group registered");
 #endif
 
+#ifdef CONFIG_BT
 	/* Initialize Bluetooth */
 	ret = bt_enable(bt_ready_cb);
 	if (ret) {
@@ -820,10 +1550,24 @@ int main(void)
 	} else {
 		printk("Bluetooth initialization started...\n");
 	}
+#else
+	LOG_INF("Bluetooth disabled - services reachable through the framed transports only");
+#endif
 
 	LOG_INF("Console available on:");
+#ifdef CONFIG_BOARD_NATIVE_SIM
+	LOG_INF("  - UART: uart0 pseudo-terminal");
+	LOG_INF("Framed data/firmware transport on uart1 pseudo-terminal");
+#else
 	LOG_INF("  - UART: pins D6(TX)/D7(RX) at 115200 baud");
 	LOG_INF("  - USB: CDC ACM device");
+#endif
+#ifdef CONFIG_USB_CDC_ACM
+	LOG_INF("Framed data/firmware transport on second USB CDC ACM device");
+#endif
+#ifdef CONFIG_UART_ASYNC_API
+	LOG_INF("COBS data transport on uart1: pins D2(TX)/D3(RX) at 1000000 baud");
+#endif
 	LOG_INF("Shell commands: led on/off, blink, status");
 
 	while (1) {
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Per-chunk AES-128-CTR decryption for encrypted firmware images. Each call
+ * sets up a fresh PSA cipher operation at the counter block of its offset,
+ * which costs a few microseconds on the CC310 but keeps decryption a pure
+ * function of (offset, data) - retried and resumed chunks just work.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <psa/crypto.h>
+
+#include "ota_crypto.h"
+
+LOG_MODULE_REGISTER(ota_crypto, LOG_LEVEL_INF);
+
+#define OTA_CRYPTO_AES_BLOCK 16
+
+/* Empty unless the build provides a key, see CONFIG_OTA_CRYPTO_KEY */
+BUILD_ASSERT(sizeof(CONFIG_OTA_CRYPTO_KEY) == 1 ||
+	     sizeof(CONFIG_OTA_CRYPTO_KEY) == 2 * OTA_CRYPTO_KEY_LEN + 1,
+	     "CONFIG_OTA_CRYPTO_KEY must be empty or 32 hex digits");
+
+static psa_key_id_t ota_key_id = PSA_KEY_ID_NULL;
+static uint8_t ota_iv[OTA_CRYPTO_IV_LEN];
+static bool ota_active;
+static struct ota_crypto_stats ota_stats;
+
+/* Keystream for the skipped head of the first block, plus CTR output slack */
+static uint8_t ota_scratch[OTA_CRYPTO_AES_BLOCK + OTA_CRYPTO_BLOCK_MAX + OTA_CRYPTO_AES_BLOCK];
+
+static int ota_crypto_load_key(void)
+{
+	uint8_t key[OTA_CRYPTO_KEY_LEN];
+
+	if (ota_key_id != PSA_KEY_ID_NULL) {
+		return 0;
+	}
+
+	if (hex2bin(CONFIG_OTA_CRYPTO_KEY, strlen(CONFIG_OTA_CRYPTO_KEY), key, sizeof(key)) !=
+	    sizeof(key)) {
+		LOG_ERR("No OTA key in this build (CONFIG_OTA_CRYPTO_KEY), refusing encrypted images");
+		return -EPERM;
+	}
+
+	psa_status_t status = psa_crypto_init();
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("PSA crypto init failed: %d", status);
+		memset(key, 0, sizeof(key));
+		return -EIO;
+	}
+
+	psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+
+	psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_DECRYPT);
+	psa_set_key_lifetime(&attr, PSA_KEY_LIFETIME_VOLATILE);
+	psa_set_key_algorithm(&attr, PSA_ALG_CTR);
+	psa_set_key_type(&attr, PSA_KEY_TYPE_AES);
+	psa_set_key_bits(&attr, OTA_CRYPTO_KEY_LEN * 8);
+
+	status = psa_import_key(&attr, key, sizeof(key), &ota_key_id);
+	psa_reset_key_attributes(&attr);
+	memset(key, 0, sizeof(key));
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Failed to import OTA key: %d", status);
+		ota_key_id = PSA_KEY_ID_NULL;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int ota_crypto_start(const uint8_t iv[OTA_CRYPTO_IV_LEN])
+{
+	int err = ota_crypto_load_key();
+
+	if (err) {
+		return err;
+	}
+
+	memcpy(ota_iv, iv, sizeof(ota_iv));
+	memset(&ota_stats, 0, sizeof(ota_stats));
+	ota_active = true;
+	LOG_INF("Encrypted image (AES-128-CTR)");
+	return 0;
+}
+
+void ota_crypto_stop(void)
+{
+	ota_active = false;
+}
+
+bool ota_crypto_active(void)
+{
+	return ota_active;
+}
+
+/* IV + block, as a 128 bit big endian add */
+static void ota_crypto_counter(uint32_t block, uint8_t counter[OTA_CRYPTO_IV_LEN])
+{
+	uint32_t carry = block;
+
+	for (int i = OTA_CRYPTO_IV_LEN - 1; i >= 0; i--) {
+		uint32_t sum = ota_iv[i] + (carry & 0xFF);
+
+		counter[i] = sum & 0xFF;
+		carry = (carry >> 8) + (sum >> 8);
+	}
+}
+
+int ota_crypto_decrypt(uint32_t offset, const uint8_t *input, uint8_t *output, size_t len)
+{
+	static const uint8_t zeros[OTA_CRYPTO_AES_BLOCK];
+	psa_cipher_operation_t op = PSA_CIPHER_OPERATION_INIT;
+	uint8_t counter[OTA_CRYPTO_IV_LEN];
+	size_t skip = offset % OTA_CRYPTO_AES_BLOCK;
+	size_t produced = 0;
+	size_t out_len;
+	uint32_t start = k_cycle_get_32();
+
+	if (!ota_active || len > OTA_CRYPTO_BLOCK_MAX) {
+		return -EINVAL;
+	}
+
+	ota_crypto_counter(offset / OTA_CRYPTO_AES_BLOCK, counter);
+
+	psa_status_t status = psa_cipher_decrypt_setup(&op, ota_key_id, PSA_ALG_CTR);
+
+	if (status == PSA_SUCCESS) {
+		status = psa_cipher_set_iv(&op, counter, sizeof(counter));
+	}
+	/* Run the keystream up to offset within its block, output discarded below */
+	if (status == PSA_SUCCESS && skip) {
+		status = psa_cipher_update(&op, zeros, skip, ota_scratch, sizeof(ota_scratch),
+					   &out_len);
+		produced += out_len;
+	}
+	if (status == PSA_SUCCESS) {
+		status = psa_cipher_update(&op, input, len, &ota_scratch[produced],
+					   sizeof(ota_scratch) - produced, &out_len);
+		produced += out_len;
+	}
+	/* Drivers may hold back a partial block until finish */
+	if (status == PSA_SUCCESS) {
+		status = psa_cipher_finish(&op, &ota_scratch[produced],
+					   sizeof(ota_scratch) - produced, &out_len);
+		produced += out_len;
+	}
+
+	if (status != PSA_SUCCESS || produced != skip + len) {
+		LOG_ERR("Decryption failed at offset %u: %d", offset, status);
+		psa_cipher_abort(&op);
+		return -EIO;
+	}
+
+	memcpy(output, &ota_scratch[skip], len);
+
+	ota_stats.bytes += len;
+	ota_stats.cycles += k_cycle_get_32() - start;
+	return 0;
+}
+
+void ota_crypto_stats_get(struct ota_crypto_stats *stats)
+{
+	*stats = ota_stats;
+}
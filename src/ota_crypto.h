@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef OTA_CRYPTO_H_
+#define OTA_CRYPTO_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * AES-128-CTR decryption of encrypted firmware images as the chunks arrive.
+ * Goes through the PSA crypto API: the CryptoCell CC310 (nrf_security) on
+ * the Xiao, the mbed TLS software implementation on native_sim.
+ *
+ * An encrypted update sends the initial counter block after the image size
+ * in FW_CMD_START. The counter for image offset N is IV + N / 16 (128 bit,
+ * big endian), so any chunk can be decrypted from its offset alone and
+ * resumed sessions need no extra state.
+ */
+#define OTA_CRYPTO_KEY_LEN   16
+#define OTA_CRYPTO_IV_LEN    16
+
+/* Largest piece decrypted per call - keeps the plaintext buffer small */
+#define OTA_CRYPTO_BLOCK_MAX 256
+
+/* Decrypted bytes and the CPU cycles spent on them since the last start */
+struct ota_crypto_stats {
+	uint32_t bytes;
+	uint32_t cycles;
+};
+
+#ifdef CONFIG_PSA_WANT_ALG_CTR
+
+/*
+ * Begin decrypting an image, returns 0, -EPERM if the build has no
+ * CONFIG_OTA_CRYPTO_KEY or -EIO if the key cannot be loaded
+ */
+int ota_crypto_start(const uint8_t iv[OTA_CRYPTO_IV_LEN]);
+
+void ota_crypto_stop(void);
+bool ota_crypto_active(void);
+
+/*
+ * Decrypt len (<= OTA_CRYPTO_BLOCK_MAX) bytes found at image offset into
+ * output. Returns 0, -EINVAL or -EIO.
+ */
+int ota_crypto_decrypt(uint32_t offset, const uint8_t *input, uint8_t *output, size_t len);
+
+void ota_crypto_stats_get(struct ota_crypto_stats *stats);
+
+#else
+
+static inline int ota_crypto_start(const uint8_t iv[OTA_CRYPTO_IV_LEN])
+{
+	return -ENOTSUP;
+}
+
+static inline void ota_crypto_stop(void)
+{
+}
+
+static inline bool ota_crypto_active(void)
+{
+	return false;
+}
+
+static inline int ota_crypto_decrypt(uint32_t offset, const uint8_t *input, uint8_t *output,
+				     size_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline void ota_crypto_stats_get(struct ota_crypto_stats *stats)
+{
+	stats->bytes = 0;
+	stats->cycles = 0;
+}
+
+#endif /* CONFIG_PSA_WANT_ALG_CTR */
+
+#endif /* OTA_CRYPTO_H_ */
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Two-class job scheduler for the GATT services. Data jobs always run
+ * first; OTA jobs run when the data queue is empty and, while data traffic
+ * is active, only as far as the OTA token bucket allows.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "qos.h"
+
+LOG_MODULE_REGISTER(qos, LOG_LEVEL_INF);
+
+K_MEM_SLAB_DEFINE_STATIC(qos_data_slab, sizeof(struct qos_job), QOS_DATA_JOBS, 4);
+K_MEM_SLAB_DEFINE_STATIC(qos_ota_slab, sizeof(struct qos_job), QOS_OTA_JOBS, 4);
+K_FIFO_DEFINE(qos_data_fifo);
+K_FIFO_DEFINE(qos_ota_fifo);
+K_SEM_DEFINE(qos_wake_sem, 0, K_SEM_MAX_LIMIT);
+
+static struct k_mem_slab *const qos_slabs[QOS_CLASS_COUNT] = {
+	[QOS_CLASS_DATA] = &qos_data_slab,
+	[QOS_CLASS_OTA] = &qos_ota_slab,
+};
+
+static struct k_fifo *const qos_fifos[QOS_CLASS_COUNT] = {
+	[QOS_CLASS_DATA] = &qos_data_fifo,
+	[QOS_CLASS_OTA] = &qos_ota_fifo,
+};
+
+/* Config and statistics are shared with the shell, under qos_lock */
+static struct k_spinlock qos_lock;
+static uint8_t qos_ota_share_pct = QOS_OTA_SHARE_PCT;
+static uint16_t qos_data_budget_ms = QOS_DATA_BUDGET_MS;
+
+struct qos_class_acc {
+	uint32_t jobs;
+	uint32_t dropped;
+	uint32_t over_budget;
+	uint32_t latency_max_us;
+	uint64_t latency_sum_us;
+	uint64_t service_sum_us;
+};
+
+static struct qos_class_acc qos_acc[QOS_CLASS_COUNT];
+
+/* Uptime of the last data submit, ms */
+static atomic_t qos_last_data_ms;
+
+/* OTA token bucket - only touched by the scheduler thread */
+static int64_t qos_ota_tokens_us;
+static int64_t qos_ota_refill_us;
+
+/* Time the running OTA job spent in qos_yield(), not charged to it */
+static uint32_t qos_yield_us;
+
+struct qos_job *qos_job_alloc(enum qos_class cls, struct bt_conn *conn, k_timeout_t timeout)
+{
+	struct qos_job *job;
+
+	if (k_mem_slab_alloc(qos_slabs[cls], (void **)&job, timeout)) {
+		k_spinlock_key_t key = k_spin_lock(&qos_lock);
+
+		qos_acc[cls].dropped++;
+		k_spin_unlock(&qos_lock, key);
+		return NULL;
+	}
+
+	job->cls = cls;
+	job->conn = conn ? bt_conn_ref(conn) : NULL;
+	job->len = 0;
+	return job;
+}
+
+void qos_submit(struct qos_job *job, qos_handler_t handler)
+{
+	job->handler = handler;
+	job->enqueued = k_cycle_get_32();
+
+	if (job->cls == QOS_CLASS_DATA) {
+		atomic_set(&qos_last_data_ms, k_uptime_get_32());
+	}
+
+	k_fifo_put(qos_fifos[job->cls], job);
+	k_sem_give(&qos_wake_sem);
+}
+
+int qos_config_set(uint8_t ota_share_pct, uint16_t data_budget_ms)
+{
+	if (ota_share_pct == 0 || ota_share_pct > 100 || data_budget_ms == 0) {
+		return -EINVAL;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&qos_lock);
+
+	qos_ota_share_pct = ota_share_pct;
+	qos_data_budget_ms = data_budget_ms;
+	k_spin_unlock(&qos_lock, key);
+
+	LOG_INF("OTA share %d%%, data latency budget %d ms", ota_share_pct, data_budget_ms);
+	return 0;
+}
+
+void qos_config_get(uint8_t *ota_share_pct, uint16_t *data_budget_ms)
+{
+	k_spinlock_key_t key = k_spin_lock(&qos_lock);
+
+	*ota_share_pct = qos_ota_share_pct;
+	*data_budget_ms = qos_data_budget_ms;
+	k_spin_unlock(&qos_lock, key);
+}
+
+void qos_stats_get(enum qos_class cls, struct qos_class_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&qos_lock);
+	const struct qos_class_acc *acc = &qos_acc[cls];
+
+	stats->jobs = acc->jobs;
+	stats->dropped = acc->dropped;
+	stats->over_budget = acc->over_budget;
+	stats->latency_max_us = acc->latency_max_us;
+	stats->latency_avg_us = acc->jobs ? acc->latency_sum_us / acc->jobs : 0;
+	stats->service_avg_us = acc->jobs ? acc->service_sum_us / acc->jobs : 0;
+	k_spin_unlock(&qos_lock, key);
+}
+
+void qos_stats_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&qos_lock);
+
+	memset(qos_acc, 0, sizeof(qos_acc));
+	k_spin_unlock(&qos_lock, key);
+}
+
+/* Run a job and account for it, returns its service time in us */
+static uint32_t qos_run(struct qos_job *job)
+{
+	uint32_t start = k_cycle_get_32();
+
+	job->handler(job);
+
+	uint32_t end = k_cycle_get_32();
+	uint32_t latency = k_cyc_to_us_floor32(end - job->enqueued);
+	uint32_t service = k_cyc_to_us_floor32(end - start);
+	uint8_t cls = job->cls;
+	k_spinlock_key_t key = k_spin_lock(&qos_lock);
+	struct qos_class_acc *acc = &qos_acc[cls];
+
+	acc->jobs++;
+	acc->latency_sum_us += latency;
+	acc->service_sum_us += service;
+	acc->latency_max_us = MAX(acc->latency_max_us, latency);
+	if (cls == QOS_CLASS_DATA && latency > qos_data_budget_ms * USEC_PER_MSEC) {
+		acc->over_budget++;
+	}
+	k_spin_unlock(&qos_lock, key);
+
+	if (job->conn) {
+		bt_conn_unref(job->conn);
+	}
+	k_mem_slab_free(qos_slabs[cls], job);
+	return service;
+}
+
+/* Microseconds until the next OTA job may start, 0 if it may start now */
+static uint32_t qos_ota_delay_us(void)
+{
+	uint8_t share;
+	uint16_t budget_ms;
+	int64_t now = k_ticks_to_us_floor64(k_uptime_ticks());
+
+	qos_config_get(&share, &budget_ms);
+
+	int64_t budget_us = (int64_t)budget_ms * USEC_PER_MSEC;
+
+	if (k_uptime_get_32() - (uint32_t)atomic_get(&qos_last_data_ms) >= QOS_DATA_IDLE_MS) {
+		/* No data traffic to protect */
+		qos_ota_tokens_us = budget_us;
+		qos_ota_refill_us = now;
+		return 0;
+	}
+
+	qos_ota_tokens_us = MIN(qos_ota_tokens_us + (now - qos_ota_refill_us) * share / 100,
+				budget_us);
+	qos_ota_refill_us = now;
+
+	if (qos_ota_tokens_us > 0) {
+		return 0;
+	}
+	return (uint32_t)(-qos_ota_tokens_us * 100 / share) + 1;
+}
+
+static void qos_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (1) {
+		struct qos_job *job = k_fifo_get(&qos_data_fifo, K_NO_WAIT);
+
+		if (job) {
+			qos_run(job);
+			continue;
+		}
+
+		if (k_fifo_is_empty(&qos_ota_fifo)) {
+			k_sem_take(&qos_wake_sem, K_FOREVER);
+			continue;
+		}
+
+		uint32_t delay = qos_ota_delay_us();
+
+		if (delay) {
+			/* Out of OTA tokens - a data submit still wakes us early */
+			k_sem_take(&qos_wake_sem, K_USEC(delay));
+			continue;
+		}
+
+		job = k_fifo_get(&qos_ota_fifo, K_NO_WAIT);
+		qos_yield_us = 0;
+		qos_ota_tokens_us -= qos_run(job) - qos_yield_us;
+	}
+}
+
+/* Below the cooperative Bluetooth threads, above the bulk transports */
+K_THREAD_DEFINE(qos_tid, 2048, qos_thread, NULL, NULL, NULL, K_PRIO_PREEMPT(6), 0, 0);
+
+void qos_yield(void)
+{
+	struct qos_job *job;
+
+	if (k_current_get() != qos_tid) {
+		return;
+	}
+
+	while ((job = k_fifo_get(&qos_data_fifo, K_NO_WAIT))) {
+		qos_yield_us += qos_run(job);
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef QOS_H_
+#define QOS_H_
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+
+/*
+ * Scheduler for the work the GATT callbacks hand off: Data Stream
+ * notifications and segmented replies run ahead of OTA jobs (chunk flash
+ * writes, control commands, status traffic), all from one thread so they
+ * no longer queue behind each other in the Bluetooth RX thread or race
+ * for TX buffers.
+ *
+ * While data traffic is active, OTA jobs draw on a token bucket that
+ * refills at the OTA bandwidth share of wall time and holds at most the
+ * data latency budget, which caps the OTA share of a busy link. A data job
+ * still waits for the OTA job already running; the longest of those is a
+ * chunk that erases the next flash page (~85 ms on the nRF52), and jobs
+ * that run longer call qos_yield(). With no data for QOS_DATA_IDLE_MS,
+ * OTA runs unthrottled.
+ */
+enum qos_class {
+	QOS_CLASS_DATA,
+	QOS_CLASS_OTA,
+	QOS_CLASS_COUNT,
+};
+
+/* Defaults, adjustable at runtime with qos_config_set() / "qos set" */
+#define QOS_OTA_SHARE_PCT     30
+#define QOS_DATA_BUDGET_MS    20
+#define QOS_DATA_IDLE_MS      200
+
+#define QOS_JOB_DATA_MAX      256
+#define QOS_DATA_JOBS         8
+#define QOS_OTA_JOBS          8
+
+struct qos_job;
+typedef void (*qos_handler_t)(struct qos_job *job);
+
+struct qos_job {
+	void *fifo_reserved;
+	qos_handler_t handler;
+	struct bt_conn *conn;
+	uint32_t enqueued;
+	uint8_t cls;
+	uint16_t len;
+	uint8_t data[QOS_JOB_DATA_MAX];
+};
+
+/* Per-class latency from submit to handler completion */
+struct qos_class_stats {
+	uint32_t jobs;
+	uint32_t dropped;
+	uint32_t over_budget;
+	uint32_t latency_avg_us;
+	uint32_t latency_max_us;
+	uint32_t service_avg_us;
+};
+
+/*
+ * Take a job from the class pool, holding a reference on conn until it has
+ * run. Returns NULL if the pool stays empty for timeout.
+ */
+struct qos_job *qos_job_alloc(enum qos_class cls, struct bt_conn *conn, k_timeout_t timeout);
+
+void qos_submit(struct qos_job *job, qos_handler_t handler);
+
+/* Returns 0 or -EINVAL for a share outside 1..100 or a zero budget */
+int qos_config_set(uint8_t ota_share_pct, uint16_t data_budget_ms);
+void qos_config_get(uint8_t *ota_share_pct, uint16_t *data_budget_ms);
+
+/*
+ * Run the queued data jobs from inside a long OTA job. Does nothing when
+ * called from any thread but the scheduler's.
+ */
+#ifdef CONFIG_BT
+void qos_yield(void);
+#else
+static inline void qos_yield(void) {}
+#endif
+
+void qos_stats_get(enum qos_class cls, struct qos_class_stats *stats);
+void qos_stats_reset(void);
+
+#endif /* QOS_H_ */
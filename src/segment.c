@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Reassembly and segmented replies for the Data Segment characteristics.
+ * Segments are copied straight into a pooled message buffer; once the final
+ * segment arrives the message is queued to the QoS scheduler as a data
+ * job, ahead of any OTA work. The job runs the transform over the
+ * reassembled input one notification at a time, so a multi-KB reply never
+ * needs a second buffer.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "qos.h"
+#include "segment.h"
+#include "transport.h"
+
+LOG_MODULE_REGISTER(segment, LOG_LEVEL_INF);
+
+struct segment_msg {
+	void *fifo_reserved;
+	struct bt_conn *conn;
+	int64_t last_rx;
+	uint16_t next_index;
+	uint16_t length;
+	uint8_t msg_id;
+	uint8_t data[SEGMENT_MSG_MAX];
+};
+
+K_MEM_SLAB_DEFINE_STATIC(segment_slab, sizeof(struct segment_msg), SEGMENT_POOL_COUNT, 4);
+
+/* Messages being reassembled - only touched from the Bluetooth RX thread */
+static struct segment_msg *segment_rx[SEGMENT_POOL_COUNT];
+
+static const struct bt_gatt_attr *segment_notify_attr;
+/* Only used from the QoS thread */
+static uint8_t segment_tx_buf[CONFIG_BT_L2CAP_TX_MTU - 3];
+
+void segment_init(const struct bt_gatt_attr *notify_attr)
+{
+	segment_notify_attr = notify_attr;
+}
+
+static void segment_release(struct segment_msg *msg)
+{
+	bt_conn_unref(msg->conn);
+	k_mem_slab_free(&segment_slab, msg);
+}
+
+static void segment_drop(int slot)
+{
+	segment_release(segment_rx[slot]);
+	segment_rx[slot] = NULL;
+}
+
+static int segment_find(struct bt_conn *conn, uint8_t msg_id)
+{
+	for (int i = 0; i < SEGMENT_POOL_COUNT; i++) {
+		if (segment_rx[i] && segment_rx[i]->conn == conn &&
+		    segment_rx[i]->msg_id == msg_id) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* Free reassembly slots whose sender went quiet (e.g. disconnected) */
+static void segment_expire(void)
+{
+	int64_t now = k_uptime_get();
+
+	for (int i = 0; i < SEGMENT_POOL_COUNT; i++) {
+		if (segment_rx[i] && now - segment_rx[i]->last_rx > SEGMENT_RX_TIMEOUT_MS) {
+			LOG_WRN("Dropping stale message %d", segment_rx[i]->msg_id);
+			segment_drop(i);
+		}
+	}
+}
+
+static int segment_alloc(struct bt_conn *conn, uint8_t msg_id)
+{
+	struct segment_msg *msg;
+
+	segment_expire();
+
+	for (int i = 0; i < SEGMENT_POOL_COUNT; i++) {
+		if (segment_rx[i]) {
+			continue;
+		}
+		if (k_mem_slab_alloc(&segment_slab, (void **)&msg, K_NO_WAIT)) {
+			break;
+		}
+
+		msg->conn = bt_conn_ref(conn);
+		msg->msg_id = msg_id;
+		msg->next_index = 0;
+		msg->length = 0;
+		segment_rx[i] = msg;
+		return i;
+	}
+
+	return -1;
+}
+
+static void segment_send(struct segment_msg *msg)
+{
+	size_t total = msg->length + 2;  // +2 for prefix
+	size_t room = MIN((size_t)bt_gatt_get_mtu(msg->conn) - 3, sizeof(segment_tx_buf)) -
+		      SEGMENT_HEADER_LEN;
+	uint16_t index = 0;
+
+	if (!bt_gatt_is_subscribed(msg->conn, segment_notify_attr, BT_GATT_CCC_NOTIFY)) {
+		LOG_WRN("Segment output notifications not enabled, dropping reply");
+		return;
+	}
+
+	for (size_t offset = 0; offset < total; index++) {
+		size_t count = MIN(room, total - offset);
+
+		segment_tx_buf[0] = msg->msg_id;
+		sys_put_le16(index, &segment_tx_buf[1]);
+		segment_tx_buf[3] = (offset + count == total) ? SEGMENT_FLAG_FINAL : 0;
+		process_data_range(msg->data, msg->length, offset,
+				   &segment_tx_buf[SEGMENT_HEADER_LEN], count);
+
+		/* Blocks for a TX buffer, which is why this runs outside the RX thread */
+		int err = bt_gatt_notify(msg->conn, segment_notify_attr, segment_tx_buf,
+					 SEGMENT_HEADER_LEN + count);
+		if (err) {
+			LOG_ERR("Failed to notify segment %d of message %d: %d", index,
+				msg->msg_id, err);
+			return;
+		}
+		offset += count;
+	}
+
+	LOG_INF("Sent message %d back in %d segments", msg->msg_id, index);
+}
+
+static void segment_reply_job(struct qos_job *job)
+{
+	struct segment_msg *msg;
+
+	memcpy(&msg, job->data, sizeof(msg));
+	segment_send(msg);
+	segment_release(msg);
+}
+
+int segment_receive(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	if (len < SEGMENT_HEADER_LEN) {
+		return -EINVAL;
+	}
+
+	uint8_t msg_id = data[0];
+	uint16_t index = sys_get_le16(&data[1]);
+	uint8_t flags = data[3];
+	int slot = segment_find(conn, msg_id);
+
+	data += SEGMENT_HEADER_LEN;
+	len -= SEGMENT_HEADER_LEN;
+
+	if (index == 0) {
+		if (slot >= 0) {
+			LOG_WRN("Message %d restarted", msg_id);
+			segment_drop(slot);
+		}
+		slot = segment_alloc(conn, msg_id);
+		if (slot < 0) {
+			LOG_ERR("No buffer for message %d", msg_id);
+			return -ENOMEM;
+		}
+	} else if (slot < 0 || segment_rx[slot]->next_index != index) {
+		LOG_ERR("Unexpected segment %d of message %d", index, msg_id);
+		if (slot >= 0) {
+			segment_drop(slot);
+		}
+		return -EINVAL;
+	}
+
+	struct segment_msg *msg = segment_rx[slot];
+
+	if (msg->length + len > SEGMENT_MSG_MAX) {
+		LOG_ERR("Message %d exceeds %d bytes", msg_id, SEGMENT_MSG_MAX);
+		segment_drop(slot);
+		return -EMSGSIZE;
+	}
+
+	memcpy(&msg->data[msg->length], data, len);
+	msg->length += len;
+	msg->next_index++;
+	msg->last_rx = k_uptime_get();
+
+	if (flags & SEGMENT_FLAG_FINAL) {
+		if (msg->length == 0) {
+			segment_drop(slot);
+			return -EINVAL;
+		}
+
+		/* The message holds the connection reference, not the job */
+		struct qos_job *job = qos_job_alloc(QOS_CLASS_DATA, NULL, K_NO_WAIT);
+
+		if (!job) {
+			LOG_WRN("Data queue full, dropping message %d", msg_id);
+			segment_drop(slot);
+			return -ENOMEM;
+		}
+		LOG_INF("Message %d complete: %d bytes in %d segments", msg_id, msg->length,
+			msg->next_index);
+		segment_rx[slot] = NULL;
+		memcpy(job->data, &msg, sizeof(msg));
+		job->len = sizeof(msg);
+		qos_submit(job, segment_reply_job);
+	}
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SEGMENT_H_
+#define SEGMENT_H_
+
+#include <stdint.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+/*
+ * Segmented messages on the Data Segment characteristics. Every write and
+ * every notification starts with a 4 byte header:
+ *
+ *   msg_id | segment index (LE16) | flags
+ *
+ * Segments of a message are written in order starting at index 0, the last
+ * one carries SEGMENT_FLAG_FINAL. The reply to message msg_id comes back as
+ * notifications with the same msg_id, split to fit the connection MTU.
+ */
+#define SEGMENT_HEADER_LEN   4
+#define SEGMENT_FLAG_FINAL   BIT(0)
+
+/* Largest reassembled message and number of messages in flight */
+#define SEGMENT_MSG_MAX      4096
+#define SEGMENT_POOL_COUNT   2
+
+/* Drop a partially received message after this long without a segment */
+#define SEGMENT_RX_TIMEOUT_MS 2000
+
+/* Characteristic used for the segmented notifications */
+void segment_init(const struct bt_gatt_attr *notify_attr);
+
+/*
+ * Add one written segment. Returns 0, -EINVAL for a malformed or out of
+ * order segment, -EMSGSIZE past SEGMENT_MSG_MAX or -ENOMEM when the pool
+ * or the data job queue is exhausted.
+ */
+int segment_receive(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+#endif /* SEGMENT_H_ */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * native_sim stand-in for the Bluetooth services: the USB framed protocol on
+ * the uart1 pseudo-terminal, so host tools can drive the data stream and the
+ * firmware update state machine (slot1 on the flash simulator) without a
+ * board. The native pty UART only offers the polling API.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+
+#include "transport.h"
+
+LOG_MODULE_REGISTER(sim_transport, LOG_LEVEL_INF);
+
+/* Idle poll period once the pty has been drained */
+#define SIM_POLL_INTERVAL K_USEC(100)
+
+static const struct device *const sim_data_dev = DEVICE_DT_GET(DT_NODELABEL(uart1));
+
+static struct frame_parser sim_parser;
+static uint8_t sim_reply[FRAME_MAX_PAYLOAD + 2];
+static uint8_t sim_frame[FRAME_MAX_LEN];
+
+static void sim_transport_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	if (!device_is_ready(sim_data_dev)) {
+		LOG_ERR("Simulated data UART not ready");
+		return;
+	}
+
+	frame_parser_reset(&sim_parser);
+	LOG_INF("Simulated data transport ready on %s", sim_data_dev->name);
+
+	while (1) {
+		uint8_t byte;
+
+		if (uart_poll_in(sim_data_dev, &byte) != 0) {
+			k_sleep(SIM_POLL_INTERVAL);
+			continue;
+		}
+
+		if (!frame_parser_feed(&sim_parser, byte)) {
+			continue;
+		}
+
+		uint8_t reply_type;
+		size_t reply_len = frame_dispatch(sim_parser.type, sim_parser.payload, sim_parser.len,
+						  sim_reply, sizeof(sim_reply), &reply_type);
+		size_t frame_len = frame_encode(sim_frame, sizeof(sim_frame), reply_type,
+						sim_reply, reply_len);
+
+		for (size_t i = 0; i < frame_len; i++) {
+			uart_poll_out(sim_data_dev, sim_frame[i]);
+		}
+	}
+}
+
+K_THREAD_DEFINE(sim_transport_tid, 2048, sim_transport_thread, NULL, NULL, NULL,
+		K_PRIO_PREEMPT(7), 0, 0);
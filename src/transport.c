@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+
+#include "transport.h"
+#include "blob_store.h"
+
+LOG_MODULE_REGISTER(transport, LOG_LEVEL_INF);
+
+enum {
+	PARSE_SOF,
+	PARSE_TYPE,
+	PARSE_LEN_LO,
+	PARSE_LEN_HI,
+	PARSE_PAYLOAD,
+	PARSE_CRC_LO,
+	PARSE_CRC_HI,
+};
+
+static uint16_t frame_crc(uint8_t type, const uint8_t *payload, uint16_t len)
+{
+	uint8_t header[3] = { type, len & 0xFF, len >> 8 };
+	uint16_t crc = crc16_itu_t(0xFFFF, header, sizeof(header));
+
+	return crc16_itu_t(crc, payload, len);
+}
+
+void frame_parser_reset(struct frame_parser *parser)
+{
+	parser->state = PARSE_SOF;
+	parser->pos = 0;
+}
+
+bool frame_parser_feed(struct frame_parser *parser, uint8_t byte)
+{
+	switch (parser->state) {
+	case PARSE_SOF:
+		if (byte == FRAME_SOF) {
+			parser->state = PARSE_TYPE;
+		}
+		break;
+
+	case PARSE_TYPE:
+		parser->type = byte;
+		parser->state = PARSE_LEN_LO;
+		break;
+
+	case PARSE_LEN_LO:
+		parser->len = byte;
+		parser->state = PARSE_LEN_HI;
+		break;
+
+	case PARSE_LEN_HI:
+		parser->len |= byte << 8;
+		parser->pos = 0;
+		if (parser->len > FRAME_MAX_PAYLOAD) {
+			LOG_WRN("Frame too large: %d bytes", parser->len);
+			frame_parser_reset(parser);
+		} else {
+			parser->state = parser->len ? PARSE_PAYLOAD : PARSE_CRC_LO;
+		}
+		break;
+
+	case PARSE_PAYLOAD:
+		parser->payload[parser->pos++] = byte;
+		if (parser->pos == parser->len) {
+			parser->state = PARSE_CRC_LO;
+		}
+		break;
+
+	case PARSE_CRC_LO:
+		parser->pos = byte;
+		parser->state = PARSE_CRC_HI;
+		break;
+
+	case PARSE_CRC_HI: {
+		uint16_t expected = parser->pos | (byte << 8);
+
+		frame_parser_reset(parser);
+		if (frame_crc(parser->type, parser->payload, parser->len) != expected) {
+			LOG_WRN("Dropping frame type 0x%02X with bad CRC", parser->type);
+			break;
+		}
+		return true;
+	}
+
+	default:
+		frame_parser_reset(parser);
+		break;
+	}
+
+	return false;
+}
+
+size_t frame_encode(uint8_t *out, size_t out_size, uint8_t type,
+		    const uint8_t *payload, uint16_t len)
+{
+	size_t total = FRAME_HEADER_LEN + len + FRAME_CRC_LEN;
+
+	if (out_size < total) {
+		return 0;
+	}
+
+	uint16_t crc = frame_crc(type, payload, len);
+
+	out[0] = FRAME_SOF;
+	out[1] = type;
+	out[2] = len & 0xFF;
+	out[3] = len >> 8;
+	memcpy(&out[FRAME_HEADER_LEN], payload, len);
+	out[FRAME_HEADER_LEN + len] = crc & 0xFF;
+	out[FRAME_HEADER_LEN + len + 1] = crc >> 8;
+
+	return total;
+}
+
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size)
+{
+	size_t code_pos = 0;
+	size_t pos = 1;
+	uint8_t code = 1;
+
+	if (out_size < COBS_MAX_ENCODED(len)) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		if (in[i] == 0) {
+			out[code_pos] = code;
+			code_pos = pos++;
+			code = 1;
+			continue;
+		}
+
+		out[pos++] = in[i];
+		if (++code == 0xFF) {
+			out[code_pos] = code;
+			code_pos = pos++;
+			code = 1;
+		}
+	}
+	out[code_pos] = code;
+
+	return pos;
+}
+
+int cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size)
+{
+	size_t pos = 0;
+	size_t i = 0;
+
+	while (i < len) {
+		uint8_t code = in[i++];
+
+		if (code == 0 || i + code - 1 > len) {
+			return -EINVAL;
+		}
+		if (pos + code - 1 > out_size) {
+			return -ENOMEM;
+		}
+
+		memcpy(&out[pos], &in[i], code - 1);
+		pos += code - 1;
+		i += code - 1;
+
+		/* A block shorter than 254 bytes ends in a zero, except at the end */
+		if (code != 0xFF && i < len) {
+			if (pos >= out_size) {
+				return -ENOMEM;
+			}
+			out[pos++] = 0;
+		}
+	}
+
+	return pos;
+}
+
+size_t frame_dispatch(uint8_t type, const uint8_t *payload, uint16_t len,
+		      uint8_t *reply, size_t reply_size, uint8_t *reply_type)
+{
+	int err;
+
+	*reply_type = type | FRAME_REPLY;
+
+	if (len > FRAME_MAX_PAYLOAD) {
+		reply[0] = (uint8_t)-EMSGSIZE;
+		return 1;
+	}
+
+	switch (type) {
+	case FRAME_DATA:
+		if (len == 0 || len + 2 > reply_size) {
+			reply[0] = (uint8_t)-EINVAL;
+			return 1;
+		}
+		process_data(payload, reply, len);
+		return len + 2;
+
+	case FRAME_FW_CONTROL:
+		err = firmware_command(payload, len);
+		break;
+
+	case FRAME_FW_CHUNK:
+		err = firmware_write_chunk(payload, len);
+		break;
+
+	case FRAME_FW_STATUS:
+		err = 0;
+		break;
+
+	case FRAME_BLOB_CONTROL:
+		err = blob_command(payload, len);
+		goto blob_reply;
+
+	case FRAME_BLOB_CHUNK:
+		err = blob_write_chunk(payload, len);
+		goto blob_reply;
+
+	case FRAME_BLOB_STATUS:
+		err = 0;
+		goto blob_reply;
+
+	default:
+		LOG_WRN("Unknown frame type 0x%02X", type);
+		*reply_type = FRAME_REPLY;
+		reply[0] = (uint8_t)-ENOTSUP;
+		return 1;
+	}
+
+	reply[0] = (uint8_t)err;
+	firmware_status_encode(&reply[1]);
+	return 1 + FIRMWARE_STATUS_LEN;
+
+blob_reply:
+	reply[0] = (uint8_t)err;
+	blob_status_encode(&reply[1]);
+	return 1 + BLOB_STATUS_LEN;
+}
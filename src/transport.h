@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Entry points into the data stream and firmware update logic (main.c).
+ * The GATT service and the framed wired transports all go through these.
+ */
+
+/* Size of the status record returned by firmware_status_encode() */
+#define FIRMWARE_STATUS_LEN 8
+
+/* Writes length + 2 bytes to output (2 byte prefix) */
+void process_data(const uint8_t *input, uint8_t *output, uint16_t length);
+
+/* Bytes [offset, offset + count) of process_data() output, for segmented replies */
+void process_data_range(const uint8_t *input, size_t length, size_t offset,
+			uint8_t *output, size_t count);
+
+/* Returns 0, -EINVAL for a malformed command or -ENOTSUP for an unknown one */
+int firmware_command(const uint8_t *data, uint16_t len);
+
+/* Returns 0, -EACCES when no update is active, -EFBIG or -EIO */
+int firmware_write_chunk(const uint8_t *data, uint16_t len);
+
+void firmware_status_encode(uint8_t status_data[FIRMWARE_STATUS_LEN]);
+
+/*
+ * Framed binary protocol used on the USB transport:
+ *
+ *   SOF(0xA5) | type | len (LE16) | payload[len] | CRC-16/CCITT-FALSE (LE16)
+ *
+ * The CRC covers type, len and payload. Every request gets exactly one reply
+ * frame with the type OR'ed with FRAME_REPLY.
+ *
+ * The UART transport carries the same type/payload/CRC as COBS packets
+ * terminated by 0x00 instead, with the CRC covering type and payload only.
+ */
+#define FRAME_SOF          0xA5
+#define FRAME_HEADER_LEN   4
+#define FRAME_CRC_LEN      2
+#define FRAME_MAX_PAYLOAD  4096
+#define FRAME_MAX_LEN      (FRAME_HEADER_LEN + FRAME_MAX_PAYLOAD + 2 + FRAME_CRC_LEN)
+
+/* Request types */
+#define FRAME_DATA         0x01  /* payload -> process_data output */
+#define FRAME_FW_CONTROL   0x02  /* payload = firmware control command */
+#define FRAME_FW_CHUNK     0x03  /* payload = firmware chunk */
+#define FRAME_FW_STATUS    0x04  /* empty payload */
+#define FRAME_BLOB_CONTROL 0x05  /* payload = blob control command */
+#define FRAME_BLOB_CHUNK   0x06  /* payload = blob chunk */
+#define FRAME_BLOB_STATUS  0x07  /* empty payload */
+#define FRAME_REPLY        0x80
+
+/*
+ * Firmware replies carry a result byte (0 or negative errno) followed by the
+ * FIRMWARE_STATUS_LEN byte status record, blob replies the same with the
+ * BLOB_STATUS_LEN byte record. A rejected FRAME_DATA request, a payload over
+ * FRAME_MAX_PAYLOAD and an unknown request type (answered as FRAME_REPLY
+ * alone) carry only the result byte.
+ */
+
+struct frame_parser {
+	uint8_t state;
+	uint8_t type;
+	uint16_t len;
+	uint16_t pos;
+	uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+void frame_parser_reset(struct frame_parser *parser);
+
+/* Returns true once a complete frame with a valid CRC has been received */
+bool frame_parser_feed(struct frame_parser *parser, uint8_t byte);
+
+/* Returns the encoded frame length, or 0 if out is too small */
+size_t frame_encode(uint8_t *out, size_t out_size, uint8_t type,
+		    const uint8_t *payload, uint16_t len);
+
+/* COBS worst case: one overhead byte per 254 bytes plus the leading code */
+#define COBS_MAX_ENCODED(len) ((len) + ((len) / 254) + 1)
+
+/* Returns the encoded length (delimiter not included), or 0 if out is too small */
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+/* Returns the decoded length, or -EINVAL / -ENOMEM */
+int cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+/*
+ * Handle one request frame. Writes the reply payload into reply and returns
+ * its length; *reply_type is set to the reply frame type.
+ */
+size_t frame_dispatch(uint8_t type, const uint8_t *payload, uint16_t len,
+		      uint8_t *reply, size_t reply_size, uint8_t *reply_type);
+
+#endif /* TRANSPORT_H_ */
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * COBS framed data stream transport on uart1 using the async (EasyDMA) UART
+ * API. RX runs double buffered out of a slab; the ISR only hands buffer
+ * regions to the transport thread, which splits them into COBS packets and
+ * returns each buffer to the slab once the driver has released it.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+
+#include "transport.h"
+
+LOG_MODULE_REGISTER(uart_transport, LOG_LEVEL_INF);
+
+#define UART_RX_BUF_SIZE    256
+#define UART_RX_BUF_COUNT   4
+/* Flush a partially filled DMA buffer after ~10 idle byte times at 1 Mbaud */
+#define UART_RX_TIMEOUT_US  100
+
+/* type + payload + CRC, before COBS encoding - FRAME_DATA replies are 2 bytes longer */
+#define UART_PACKET_MAX     (1 + FRAME_MAX_PAYLOAD + 2 + FRAME_CRC_LEN)
+
+static const struct device *const uart_data_dev = DEVICE_DT_GET(DT_NODELABEL(uart1));
+
+K_MEM_SLAB_DEFINE_STATIC(uart_rx_slab, UART_RX_BUF_SIZE, UART_RX_BUF_COUNT, 4);
+
+/* RX events handed from the UART callback to the transport thread */
+enum uart_rx_evt_type {
+	UART_RX_EVT_DATA,
+	UART_RX_EVT_RELEASED,
+	UART_RX_EVT_DISABLED,
+};
+
+struct uart_rx_evt {
+	uint8_t type;
+	uint16_t len;
+	uint8_t *buf;
+};
+
+K_MSGQ_DEFINE(uart_rx_msgq, sizeof(struct uart_rx_evt), 32, 4);
+
+/*
+ * Slots data events leave free: one release per slab buffer and one
+ * disable, so neither can be dropped and leak a buffer or stall RX
+ */
+#define UART_RX_EVT_RESERVED (UART_RX_BUF_COUNT + 1)
+K_SEM_DEFINE(uart_tx_done_sem, 0, 1);
+
+static uint8_t uart_encoded[COBS_MAX_ENCODED(UART_PACKET_MAX)];
+static size_t uart_encoded_len;
+static bool uart_encoded_overflow;
+
+static uint8_t uart_packet[UART_PACKET_MAX];
+static uint8_t uart_reply[FRAME_MAX_PAYLOAD + 2];
+static uint8_t uart_tx_buf[COBS_MAX_ENCODED(UART_PACKET_MAX) + 1];
+
+static void uart_rx_evt_post(uint8_t type, uint8_t *buf, uint16_t len)
+{
+	struct uart_rx_evt evt = { .type = type, .len = len, .buf = buf };
+
+	/* Only called from the UART callback, so the free count cannot drop meanwhile */
+	if (type == UART_RX_EVT_DATA &&
+	    k_msgq_num_free_get(&uart_rx_msgq) <= UART_RX_EVT_RESERVED) {
+		LOG_WRN("UART RX event queue full, dropping %d bytes", len);
+		return;
+	}
+
+	if (k_msgq_put(&uart_rx_msgq, &evt, K_NO_WAIT)) {
+		LOG_ERR("UART RX event queue full");
+	}
+}
+
+static void uart_data_callback(const struct device *dev, struct uart_event *evt, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	switch (evt->type) {
+	case UART_RX_RDY:
+		uart_rx_evt_post(UART_RX_EVT_DATA, evt->data.rx.buf + evt->data.rx.offset,
+				 evt->data.rx.len);
+		break;
+
+	case UART_RX_BUF_REQUEST: {
+		uint8_t *buf;
+
+		/* Without a spare buffer RX stops once the current one fills up */
+		if (k_mem_slab_alloc(&uart_rx_slab, (void **)&buf, K_NO_WAIT) == 0) {
+			uart_rx_buf_rsp(dev, buf, UART_RX_BUF_SIZE);
+		}
+		break;
+	}
+
+	case UART_RX_BUF_RELEASED:
+		uart_rx_evt_post(UART_RX_EVT_RELEASED, evt->data.rx_buf.buf, 0);
+		break;
+
+	case UART_RX_DISABLED:
+		uart_rx_evt_post(UART_RX_EVT_DISABLED, NULL, 0);
+		break;
+
+	case UART_RX_STOPPED:
+		LOG_WRN("UART RX stopped (reason %d)", evt->data.rx_stop.reason);
+		break;
+
+	case UART_TX_DONE:
+	case UART_TX_ABORTED:
+		k_sem_give(&uart_tx_done_sem);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static int uart_rx_start(void)
+{
+	uint8_t *buf;
+	/* Buffers are only freed by the caller's thread, so waiting here would never end */
+	int err = k_mem_slab_alloc(&uart_rx_slab, (void **)&buf, K_NO_WAIT);
+
+	if (err) {
+		return -ENOMEM;
+	}
+
+	err = uart_rx_enable(uart_data_dev, buf, UART_RX_BUF_SIZE, UART_RX_TIMEOUT_US);
+	if (err) {
+		k_mem_slab_free(&uart_rx_slab, buf);
+	}
+	return err;
+}
+
+static void uart_transport_send(uint8_t type, const uint8_t *payload, size_t len)
+{
+	if (len + 1 + FRAME_CRC_LEN > sizeof(uart_packet)) {
+		LOG_ERR("Reply too large for UART transport");
+		return;
+	}
+
+	/* Encode type | payload | CRC into the packet scratch buffer first */
+	uart_packet[0] = type;
+	memcpy(&uart_packet[1], payload, len);
+
+	uint16_t crc = crc16_itu_t(0xFFFF, uart_packet, len + 1);
+
+	uart_packet[len + 1] = crc & 0xFF;
+	uart_packet[len + 2] = crc >> 8;
+
+	size_t encoded = cobs_encode(uart_packet, len + 3, uart_tx_buf, sizeof(uart_tx_buf) - 1);
+
+	if (encoded == 0) {
+		LOG_ERR("Reply too large for UART transport");
+		return;
+	}
+	uart_tx_buf[encoded++] = 0x00;
+
+	k_sem_reset(&uart_tx_done_sem);
+	if (uart_tx(uart_data_dev, uart_tx_buf, encoded, SYS_FOREVER_US) == 0) {
+		k_sem_take(&uart_tx_done_sem, K_FOREVER);
+	}
+}
+
+static void uart_packet_handle(void)
+{
+	int len = cobs_decode(uart_encoded, uart_encoded_len, uart_packet, sizeof(uart_packet));
+
+	if (len < 1 + FRAME_CRC_LEN) {
+		LOG_WRN("Dropping malformed UART packet (%d)", len);
+		return;
+	}
+
+	len -= FRAME_CRC_LEN;
+	uint16_t expected = uart_packet[len] | (uart_packet[len + 1] << 8);
+
+	if (crc16_itu_t(0xFFFF, uart_packet, len) != expected) {
+		LOG_WRN("Dropping UART packet type 0x%02X with bad CRC", uart_packet[0]);
+		return;
+	}
+
+	uint8_t reply_type;
+	size_t reply_len = frame_dispatch(uart_packet[0], &uart_packet[1], len - 1,
+					  uart_reply, sizeof(uart_reply), &reply_type);
+
+	uart_transport_send(reply_type, uart_reply, reply_len);
+}
+
+static void uart_rx_consume(const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (data[i] != 0x00) {
+			if (uart_encoded_len < sizeof(uart_encoded)) {
+				uart_encoded[uart_encoded_len++] = data[i];
+			} else {
+				uart_encoded_overflow = true;
+			}
+			continue;
+		}
+
+		if (uart_encoded_overflow) {
+			LOG_WRN("Dropping oversized UART packet");
+		} else if (uart_encoded_len > 0) {
+			uart_packet_handle();
+		}
+		uart_encoded_len = 0;
+		uart_encoded_overflow = false;
+	}
+}
+
+static void uart_transport_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	if (!device_is_ready(uart_data_dev)) {
+		LOG_ERR("UART data device not ready");
+		return;
+	}
+
+	int err = uart_callback_set(uart_data_dev, uart_data_callback, NULL);
+
+	if (err) {
+		LOG_ERR("UART async API not available: %d", err);
+		return;
+	}
+
+	err = uart_rx_start();
+	if (err) {
+		LOG_ERR("Failed to enable UART RX: %d", err);
+		return;
+	}
+	LOG_INF("UART data transport ready on %s", uart_data_dev->name);
+
+	/* Set while RX is down and could not be restarted yet */
+	bool rx_stopped = false;
+
+	while (1) {
+		struct uart_rx_evt evt;
+
+		if (k_msgq_get(&uart_rx_msgq, &evt, rx_stopped ? K_MSEC(10) : K_FOREVER)) {
+			rx_stopped = uart_rx_start() != 0;
+			continue;
+		}
+
+		switch (evt.type) {
+		case UART_RX_EVT_DATA:
+			uart_rx_consume(evt.buf, evt.len);
+			break;
+
+		case UART_RX_EVT_RELEASED:
+			/* All data events for this buffer were queued before the release */
+			k_mem_slab_free(&uart_rx_slab, evt.buf);
+			break;
+
+		case UART_RX_EVT_DISABLED:
+			/* Ran out of buffers while the thread was busy - restart reception */
+			err = uart_rx_start();
+			if (err) {
+				LOG_ERR("Failed to restart UART RX: %d, retrying", err);
+			}
+			rx_stopped = err != 0;
+			break;
+		}
+	}
+}
+
+/* Preemptible, so the cooperative Bluetooth host threads always run first */
+K_THREAD_DEFINE(uart_transport_tid, 2048, uart_transport_thread, NULL, NULL, NULL,
+		K_PRIO_PREEMPT(8), 0, 0);
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Framed data stream / firmware update transport on the second USB CDC ACM
+ * instance (cdc_acm_data). The console keeps the first instance.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "transport.h"
+
+LOG_MODULE_REGISTER(usb_transport, LOG_LEVEL_INF);
+
+#define USB_RX_RING_SIZE 4096
+#define USB_TX_RING_SIZE 1024
+#define USB_FIFO_BURST   64
+
+static const struct device *const usb_data_dev = DEVICE_DT_GET(DT_NODELABEL(cdc_acm_data));
+
+RING_BUF_DECLARE(usb_rx_ringbuf, USB_RX_RING_SIZE);
+RING_BUF_DECLARE(usb_tx_ringbuf, USB_TX_RING_SIZE);
+static struct k_spinlock usb_tx_lock;
+
+K_SEM_DEFINE(usb_rx_sem, 0, 1);
+K_SEM_DEFINE(usb_tx_sem, 0, 1);
+
+static struct frame_parser usb_parser;
+static uint8_t usb_reply[FRAME_MAX_PAYLOAD + 2];
+static uint8_t usb_frame[FRAME_MAX_LEN];
+
+static void usb_data_irq_handler(const struct device *dev, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+		if (uart_irq_rx_ready(dev)) {
+			uint8_t buf[USB_FIFO_BURST];
+			uint32_t space = ring_buf_space_get(&usb_rx_ringbuf);
+
+			if (space == 0) {
+				/* Stop reading so the host gets NAKed until we catch up */
+				uart_irq_rx_disable(dev);
+			} else {
+				int n = uart_fifo_read(dev, buf, MIN(space, sizeof(buf)));
+
+				if (n > 0) {
+					ring_buf_put(&usb_rx_ringbuf, buf, n);
+					k_sem_give(&usb_rx_sem);
+				}
+			}
+		}
+
+		if (uart_irq_tx_ready(dev)) {
+			k_spinlock_key_t key = k_spin_lock(&usb_tx_lock);
+			uint8_t *data;
+			uint32_t n = ring_buf_get_claim(&usb_tx_ringbuf, &data, USB_FIFO_BURST);
+
+			if (n == 0) {
+				uart_irq_tx_disable(dev);
+			} else {
+				int sent = uart_fifo_fill(dev, data, n);
+
+				ring_buf_get_finish(&usb_tx_ringbuf, MAX(sent, 0));
+				k_sem_give(&usb_tx_sem);
+			}
+			k_spin_unlock(&usb_tx_lock, key);
+		}
+	}
+}
+
+static void usb_transport_send(const uint8_t *data, size_t len)
+{
+	while (len > 0) {
+		k_spinlock_key_t key = k_spin_lock(&usb_tx_lock);
+		uint32_t n = ring_buf_put(&usb_tx_ringbuf, data, len);
+
+		k_spin_unlock(&usb_tx_lock, key);
+		uart_irq_tx_enable(usb_data_dev);
+
+		data += n;
+		len -= n;
+		if (len > 0 && k_sem_take(&usb_tx_sem, K_MSEC(1000)) != 0) {
+			LOG_WRN("USB TX stalled, dropping %d bytes", len);
+			return;
+		}
+	}
+}
+
+static void usb_transport_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	if (!device_is_ready(usb_data_dev)) {
+		LOG_ERR("USB data CDC ACM device not ready");
+		return;
+	}
+
+	frame_parser_reset(&usb_parser);
+	uart_irq_callback_set(usb_data_dev, usb_data_irq_handler);
+	uart_irq_rx_enable(usb_data_dev);
+	LOG_INF("USB data transport ready on %s", usb_data_dev->name);
+
+	while (1) {
+		uint8_t *data;
+		uint32_t n;
+
+		k_sem_take(&usb_rx_sem, K_FOREVER);
+
+		while ((n = ring_buf_get_claim(&usb_rx_ringbuf, &data, USB_RX_RING_SIZE)) > 0) {
+			for (uint32_t i = 0; i < n; i++) {
+				if (!frame_parser_feed(&usb_parser, data[i])) {
+					continue;
+				}
+
+				uint8_t reply_type;
+				size_t reply_len = frame_dispatch(usb_parser.type, usb_parser.payload,
+								  usb_parser.len, usb_reply,
+								  sizeof(usb_reply), &reply_type);
+				size_t frame_len = frame_encode(usb_frame, sizeof(usb_frame),
+								reply_type, usb_reply, reply_len);
+
+				usb_transport_send(usb_frame, frame_len);
+			}
+			ring_buf_get_finish(&usb_rx_ringbuf, n);
+
+			/* Space is available again if the ISR had to pause reception */
+			uart_irq_rx_enable(usb_data_dev);
+		}
+	}
+}
+
+K_THREAD_DEFINE(usb_transport_tid, 2048, usb_transport_thread, NULL, NULL, NULL,
+		K_PRIO_PREEMPT(7), 0, 0);
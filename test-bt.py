@@ -1,13 +1,152 @@
+import argparse
 import asyncio
-from bleak import BleakScanner, BleakClient
+import struct
 import time
 
+from host_transport import FRAME_DATA, open_link
+
 # Custom Data Stream Service UUIDs (from our device)
 DATA_STREAM_SERVICE_UUID = "12345678-1234-5678-9abc-def012345678"
 DATA_INPUT_CHAR_UUID = "12345678-1234-5678-9abc-def012345679"      # Write to this
 DATA_OUTPUT_CHAR_UUID = "12345678-1234-5678-9abc-def01234567a"     # Read/Notify from this
+DATA_SEGMENT_INPUT_CHAR_UUID = "12345678-1234-5678-9abc-def01234567e"   # Large messages, segmented
+DATA_SEGMENT_OUTPUT_CHAR_UUID = "12345678-1234-5678-9abc-def01234567f"  # Segmented replies
+
+# Segment header: msg_id, LE16 segment index, flags (see src/segment.h)
+SEGMENT_HEADER = struct.Struct('<BHB')
+SEGMENT_FLAG_FINAL = 0x01
+SEGMENT_MSG_MAX = 4096
+
+# Test data streaming with different payloads
+TEST_PAYLOADS = [
+    bytes([0x01, 0x02, 0x03, 0x04, 0x05]),
+    b"Hello",
+    bytes(range(10)),  # 0x00 to 0x09
+    b"BLE_DATA_STREAM_TEST",
+]
+
+
+def expected_output(data):
+    """Reference for process_data(): BEEF prefix, then reversed bytes XOR 0xAA"""
+    return bytes([0xBE, 0xEF]) + bytes(b ^ 0xAA for b in reversed(data))
+
+
+def parse_user_input(user_input):
+    # Try to parse as hex first
+    if all(c in '0123456789abcdefABCDEF' for c in user_input.replace(' ', '')):
+        # Remove spaces and convert hex to bytes
+        hex_str = user_input.replace(' ', '')
+        if len(hex_str) % 2 == 0:
+            return bytes.fromhex(hex_str)
+        raise ValueError("Odd number of hex digits")
+    # Treat as ASCII text
+    return user_input.encode('utf-8')
+
+
+def run_wired(link, bench=0, payload_size=244, interactive=True):
+    """Same tests over a host_transport link (USB, UART or the native_sim emulator)"""
+    link.open()
+    failures = 0
+    try:
+        for i, payload in enumerate(TEST_PAYLOADS, 1):
+            print(f"\n🚀 Test {i}: Sending {len(payload)} bytes: {payload.hex()}")
+            reply = link.transact(FRAME_DATA, payload)
+            ok = reply == expected_output(payload)
+            failures += not ok
+            print(f"📤 Received processed data: {reply.hex()} ({len(reply)} bytes) {'✅' if ok else '❌'}")
+        
+        if bench:
+            payload = bytes(i & 0xFF for i in range(payload_size))
+            expected = expected_output(payload)
+            print(f"\n⏱️  Benchmark: {bench} round trips of {payload_size} bytes")
+            start = time.monotonic()
+            for _ in range(bench):
+                if link.transact(FRAME_DATA, payload) != expected:
+                    failures += 1
+            elapsed = time.monotonic() - start
+            print(f"   {bench / elapsed:.0f} messages/s, {bench * payload_size / elapsed / 1024:.1f} KB/s, "
+                  f"{elapsed / bench * 1000:.2f} ms per round trip")
+        
+        if interactive:
+            print(f"\n🎮 Interactive mode - Enter hex data to send (or 'quit' to exit):")
+            while True:
+                user_input = input("Data to send: ").strip()
+                if user_input.lower() in ['quit', 'exit', 'q']:
+                    break
+                try:
+                    data = parse_user_input(user_input)
+                    print(f"📤 Sending: {data.hex()} ({len(data)} bytes)")
+                    print(f"📤 Received processed data: {link.transact(FRAME_DATA, data).hex()}")
+                except Exception as e:
+                    print(f"❌ Error: {e}")
+    finally:
+        link.close()
+    
+    print(f"\n{'✅ All checks passed' if failures == 0 else f'❌ {failures} check(s) failed'}")
+    return failures == 0
+
+
+class SegmentReceiver:
+    """Reassembles segmented replies from the Data Segment Output notifications"""
+
+    def __init__(self):
+        self.parts = {}
+        self.done = {}
+        self.events = {}
 
-async def main():
+    def handle(self, _, data):
+        msg_id, index, flags = SEGMENT_HEADER.unpack_from(data)
+        parts = self.parts.setdefault(msg_id, [])
+        if index != len(parts):
+            print(f"❌ Segment {index} of message {msg_id} out of order")
+            return
+        parts.append(bytes(data[SEGMENT_HEADER.size:]))
+        if flags & SEGMENT_FLAG_FINAL:
+            self.done[msg_id] = b''.join(self.parts.pop(msg_id))
+            self.events.setdefault(msg_id, asyncio.Event()).set()
+
+    async def wait(self, msg_id, timeout=10.0):
+        await asyncio.wait_for(self.events.setdefault(msg_id, asyncio.Event()).wait(), timeout)
+        del self.events[msg_id]
+        return self.done.pop(msg_id)
+
+
+async def send_segmented(client, msg_id, data):
+    """Write one message as MTU sized segments to the Data Segment Input characteristic"""
+    room = client.mtu_size - 3 - SEGMENT_HEADER.size
+    segments = [data[i:i + room] for i in range(0, len(data), room)]
+    for index, segment in enumerate(segments):
+        flags = SEGMENT_FLAG_FINAL if index == len(segments) - 1 else 0
+        await client.write_gatt_char(DATA_SEGMENT_INPUT_CHAR_UUID,
+                                     SEGMENT_HEADER.pack(msg_id, index, flags) + segment,
+                                     response=True)
+    return len(segments)
+
+
+async def run_segmented(client, size, count=3):
+    """Round trip messages larger than one write through the segmented characteristics"""
+    receiver = SegmentReceiver()
+    await client.start_notify(DATA_SEGMENT_OUTPUT_CHAR_UUID, receiver.handle)
+    failures = 0
+    try:
+        print(f"\n🧩 Segmented test: {count} messages of {size} bytes (MTU {client.mtu_size})")
+        start = time.monotonic()
+        for msg_id in range(count):
+            payload = bytes((i * 7 + msg_id) & 0xFF for i in range(size))
+            segments = await send_segmented(client, msg_id, payload)
+            reply = await receiver.wait(msg_id)
+            ok = reply == expected_output(payload)
+            failures += not ok
+            print(f"   Message {msg_id}: {segments} segments, {len(reply)} bytes back {'✅' if ok else '❌'}")
+        elapsed = time.monotonic() - start
+        print(f"   {count * size / elapsed / 1024:.1f} KB/s round trip")
+    finally:
+        await client.stop_notify(DATA_SEGMENT_OUTPUT_CHAR_UUID)
+    return failures == 0
+
+
+async def run_ble(segment_size=0):
+    from bleak import BleakScanner, BleakClient
     print("🔍 Scanning for AlexBlue...")
     devices = await BleakScanner.discover()
     target = None
@@ -46,15 +185,7 @@ async def main():
             print(f"❌ Failed to enable notifications: {e}")
             return
         
-        # Test data streaming with different payloads
-        test_payloads = [
-            bytes([0x01, 0x02, 0x03, 0x04, 0x05]),
-            b"Hello",
-            bytes(range(10)),  # 0x00 to 0x09
-            b"BLE_DATA_STREAM_TEST",
-        ]
-        
-        for i, payload in enumerate(test_payloads, 1):
+        for i, payload in enumerate(TEST_PAYLOADS, 1):
             print(f"\n🚀 Test {i}: Sending {len(payload)} bytes: {payload.hex()}")
             print(f"   As text: {payload}")
             
@@ -69,6 +200,12 @@ async def main():
             except Exception as e:
                 print(f"❌ Failed to send data: {e}")
         
+        if segment_size:
+            try:
+                await run_segmented(client, segment_size)
+            except Exception as e:
+                print(f"❌ Segmented test failed: {e}")
+        
         # Read the latest processed data directly
         print(f"\n📖 Reading data output characteristic directly...")
         try:
@@ -88,17 +225,7 @@ async def main():
                 break
             
             try:
-                # Try to parse as hex first
-                if all(c in '0123456789abcdefABCDEF' for c in user_input.replace(' ', '')):
-                    # Remove spaces and convert hex to bytes
-                    hex_str = user_input.replace(' ', '')
-                    if len(hex_str) % 2 == 0:
-                        data = bytes.fromhex(hex_str)
-                    else:
-                        raise ValueError("Odd number of hex digits")
-                else:
-                    # Treat as ASCII text
-                    data = user_input.encode('utf-8')
+                data = parse_user_input(user_input)
                 
                 print(f"📤 Sending: {data.hex()} ({len(data)} bytes)")
                 await client.write_gatt_char(DATA_INPUT_CHAR_UUID, data)
@@ -116,5 +243,29 @@ async def main():
         
         print("👋 Disconnecting...")
 
+def main():
+    parser = argparse.ArgumentParser(description="Data Stream service test")
+    parser.add_argument("--transport", choices=["ble", "usb", "uart", "sim"], default="ble",
+                        help="Link to the device (sim = native_sim emulator pty)")
+    parser.add_argument("--port", default=None, help="Serial port of the wired transport")
+    parser.add_argument("--baudrate", type=int, default=1000000, help="Baud rate of the data stream UART")
+    parser.add_argument("--bench", type=int, default=0, help="Round trips to time after the tests (wired only)")
+    parser.add_argument("--payload-size", type=int, default=244, help="Benchmark payload size")
+    parser.add_argument("--segment-size", type=int, default=0,
+                        help=f"Also round trip messages of this size (up to {SEGMENT_MSG_MAX}) "
+                             "through the segmented characteristics (BLE only)")
+    parser.add_argument("--no-interactive", action="store_true", help="Exit after the tests (for CI)")
+    args = parser.parse_args()
+    
+    if args.transport == "ble":
+        if args.segment_size > SEGMENT_MSG_MAX:
+            parser.error(f"--segment-size is limited to {SEGMENT_MSG_MAX} bytes")
+        asyncio.run(run_ble(args.segment_size))
+    else:
+        ok = run_wired(open_link(args.transport, args.port, args.baudrate),
+                       args.bench, args.payload_size, not args.no_interactive)
+        raise SystemExit(0 if ok else 1)
+
+
 if __name__ == "__main__":
-    asyncio.run(main())
\ No newline at end of file
+    main()
\ No newline at end of file